@@ -0,0 +1,95 @@
+#include "world.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+// swings chains of links pinned together by revolute joints, with a heavy load on the last link, from their first link
+// and measures how far the joints come apart, solved by sequential impulses with more and more iterations and by the global mode
+// the sequential impulses hold the joints softly at joint_hertz, so more iterations cost more without closing the gap,
+// the global mode solves them rigidly and directly, so one iteration holds any chain
+
+struct chain_result
+{
+	float gap; // largest distance between the anchors of any joint during the swing, in link lengths
+	double step_us;
+};
+
+static chain_result run_chain(int links, float load, physics::solver_mode mode, int iterations)
+{
+	constexpr float seconds = 3;
+	constexpr float frame = 1.f / 60;
+	constexpr float length = 1;
+
+	static auto box = physics::make_regular<4>();
+	physics::shape_view view(box, {0, 0}, {1, 1}, 0);
+	float size = view.bounds().max.x - view.bounds().min.x;
+	glm::vec2 scale{length / size, .2f / size};
+
+	physics::world w(4.f * links + 4, 4.f * links + 4, -10);
+	w.settings().mode = mode;
+	w.settings().velocity_iterations = iterations;
+	w.settings().global_iterations = iterations;
+	// the iterations under test are run even once the residual is small
+	w.settings().residual_tolerance = 0;
+	w.settings().sleeping = false;
+
+	// the links overlap at the joints, a shared negative group keeps them from colliding
+	physics::collision_filter chain_filter{1, ~std::uint32_t{}, -1};
+	glm::vec2 pivot{2.f * links + 2, 3.f * links + 2};
+	physics::object *prev = w.add_static_object(box, pivot, 0, {.2f / size, .2f / size}, chain_filter);
+	std::vector<physics::constraint_handle> joints;
+	for (int i = 0; i < links; ++i)
+	{
+		// starting out level, so the chain swings down and whips
+		float mass = i == links - 1 ? load : 1;
+		auto *link = w.add_object(box, pivot + glm::vec2{(i + .5f) * length, 0}, {}, 0, 0, mass, scale, chain_filter);
+		joints.push_back(w.add_revolute_joint(*prev, *link, pivot + glm::vec2{i * length, 0}));
+		prev = link;
+	}
+
+	chain_result res{};
+	std::size_t steps = 0;
+	double elapsed = 0;
+	for (float t = 0; t < seconds; t += frame)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		w.update(frame);
+		elapsed += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+		steps += w.stats().steps;
+
+		// the joints keep the gap at the start of their last step as bias
+		for (auto h : joints)
+		{
+			const auto *j = w.find_constraint<physics::revolute_joint>(h);
+			res.gap = std::max(res.gap, glm::length(j->bias) / j->soft.bias_rate / length);
+		}
+	}
+
+	res.step_us = elapsed / steps;
+	return res;
+}
+
+int main()
+{
+	const int chain_links[] = {5, 20, 50};
+	const float loads[] = {1, 100};
+	const int iterations[] = {8, 32, 128};
+
+	std::cout << std::setw(8) << "links" << std::setw(8) << "load" << std::setw(12) << "solver" << std::setw(12) << "iterations"
+			  << std::setw(12) << "gap" << std::setw(12) << "us/step" << '\n';
+
+	auto print = [](int links, float load, const char *solver, int n, chain_result res)
+	{
+		std::cout << std::setw(8) << links << std::setw(8) << load << std::setw(12) << solver << std::setw(12) << n
+				  << std::setw(12) << std::setprecision(3) << res.gap << std::setw(12) << res.step_us << '\n';
+	};
+
+	for (int links : chain_links)
+		for (float load : loads)
+		{
+			for (int n : iterations)
+				print(links, load, "impulses", n, run_chain(links, load, physics::solver_mode::impulses, n));
+			print(links, load, "global", 1, run_chain(links, load, physics::solver_mode::global, 1));
+		}
+}
@@ -1,4 +1,7 @@
 #include "world.h"
+#include "compound.h"
+#include "geometry.h"
+#include "terrain.h"
 #include "draw.h"
 
 #include <chrono>
@@ -42,6 +45,7 @@ int main(int argc, char **argv)
 	float time_multiplier = 1.0;
 	bool left_shift_released = true;
 	bool left_ctrl_released = true;
+	bool p_released = true;
 	while (!glfwWindowShouldClose(win.handle))
 	{
 		std::chrono::time_point frame_begin = std::chrono::steady_clock::now();
@@ -75,10 +79,33 @@ int main(int argc, char **argv)
 		
 		handler.update(1.f / target_fps * time_multiplier);
 
+		if (glfwGetKey(win.handle, GLFW_KEY_P) == GLFW_PRESS)
+		{
+			if (p_released)
+			{
+				const auto &stats = handler.stats();
+				std::cout << "steps: " << stats.steps << ", broadphase pairs: " << stats.broadphase_pairs
+						  << ", filtered: " << stats.filtered_pairs << ", narrowphase: " << stats.narrowphase_tests
+						  << ", sensor tests: " << stats.sensor_tests << ", sensor events: " << handler.sensor_events().size()
+						  << ", contact events: " << handler.contact_events().size()
+						  << ", collisions: " << stats.collisions << ", velocity iterations: " << stats.velocity_iterations
+						  << ", skipped: " << stats.skipped_iterations << ", residual: " << stats.residual << std::endl;
+
+				const auto &islands = handler.last_islands();
+				std::cout << "islands: " << islands.count << ", largest: " << islands.largest << ", split: " << islands.split << ", sleeping objects: " << islands.sleeping << ", sizes:";
+				for (auto n : islands.sizes)
+					std::cout << ' ' << n;
+				std::cout << ", iterations: " << islands.iterations << ", most: " << islands.most_iterations << ", residual: " << islands.residual << std::endl;
+				p_released = false;
+			}
+		}
+		else
+			p_released = true;
+
 		glClearColor(1, 1, 1, 1);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		world_drawer.draw(gl);
+		world_drawer.draw(gl, handler);
 
 		glfwSwapBuffers(win.handle);
 
@@ -93,6 +120,7 @@ int main(int argc, char **argv)
 }
 
 #include <unordered_map>
+#include <algorithm>
 #include <fstream>
 #include "json.hpp"
 
@@ -124,11 +152,319 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 
 	physics::world res(data["width"], data["height"], gravity);
 
-	static auto triangle = physics::regular_polygon(3);
-	static auto pentagon = physics::regular_polygon(5);
-	static auto rect = physics::regular_polygon(4);
-	static auto circle = physics::regular_polygon(100);
-	static auto hexagon = physics::regular_polygon(6);
+	if (data.contains("solver"))
+	{
+		auto &s = data["solver"];
+		if (s.contains("mode"))
+		{
+			if (s["mode"] == "xpbd")
+				res.settings().mode = physics::solver_mode::xpbd;
+			else if (s["mode"] == "global")
+				res.settings().mode = physics::solver_mode::global;
+			else if (s["mode"] != "impulses")
+				std::cerr << "Unknown solver mode: " << s["mode"] << std::endl;
+		}
+		if (s.contains("time_step"))
+			res.settings().time_step = s["time_step"];
+		if (s.contains("max_steps"))
+			res.settings().max_steps = s["max_steps"];
+		if (s.contains("xpbd_step"))
+			res.settings().xpbd_step = s["xpbd_step"];
+		if (s.contains("substeps"))
+			res.settings().substeps = s["substeps"];
+		if (s.contains("contact_hertz"))
+			res.settings().contact_hertz = s["contact_hertz"];
+		if (s.contains("contact_damping_ratio"))
+			res.settings().contact_damping_ratio = s["contact_damping_ratio"];
+		if (s.contains("joint_hertz"))
+			res.settings().joint_hertz = s["joint_hertz"];
+		if (s.contains("joint_damping_ratio"))
+			res.settings().joint_damping_ratio = s["joint_damping_ratio"];
+		if (s.contains("contact_push_velocity"))
+			res.settings().contact_push_velocity = s["contact_push_velocity"];
+		if (s.contains("velocity_iterations"))
+			res.settings().velocity_iterations = s["velocity_iterations"];
+		if (s.contains("residual_tolerance"))
+			res.settings().residual_tolerance = s["residual_tolerance"];
+		if (s.contains("position_iterations"))
+			res.settings().position_iterations = s["position_iterations"];
+		if (s.contains("global_iterations"))
+			res.settings().global_iterations = s["global_iterations"];
+		if (s.contains("restitution_threshold"))
+			res.settings().restitution_threshold = s["restitution_threshold"];
+		if (s.contains("warm_starting"))
+			res.settings().warm_starting = s["warm_starting"];
+		if (s.contains("block_solver"))
+			res.settings().block_solver = s["block_solver"];
+		if (s.contains("threads"))
+			res.settings().threads = s["threads"];
+		if (s.contains("simd"))
+			res.settings().simd = s["simd"];
+		if (s.contains("direct_trees"))
+			res.settings().direct_trees = s["direct_trees"];
+		if (s.contains("shock_propagation"))
+			res.settings().shock_propagation = s["shock_propagation"];
+		if (s.contains("sleeping"))
+			res.settings().sleeping = s["sleeping"];
+		if (s.contains("time_to_sleep"))
+			res.settings().time_to_sleep = s["time_to_sleep"];
+	}
+
+	static auto triangle = physics::make_regular(3);
+	static auto pentagon = physics::make_regular(5);
+	static auto rect = physics::make_regular(4);
+	static auto circle = physics::make_regular(100);
+	static auto hexagon = physics::make_regular(6);
+
+	// shapes defined in the config file, they have to outlive the world
+	static std::vector<std::unique_ptr<physics::abstract_shape>> custom_shapes;
+	static physics::decomposition_cache decompositions;
+
+	std::unordered_map<std::string, const physics::abstract_shape *> shapes = {
+		{"triangle", &triangle},
+		{"pentagon", &pentagon},
+		{"rectangle", &rect},
+		{"circle", &circle},
+		{"hexagon", &hexagon},
+	};
+
+	if (data.contains("shapes"))
+	{
+		int i = 0;
+		for (auto &s : data["shapes"])
+		{
+			++i;
+			if (!s.contains("name"))
+			{
+				std::cerr << "No name in shape #" << i << std::endl;
+				continue;
+			}
+
+			if (shapes.find(s["name"]) != shapes.end())
+			{
+				std::cerr << "Duplicate shape name: " << s["name"] << std::endl;
+				continue;
+			}
+
+			if (!s.contains("type"))
+			{
+				std::cerr << "No type in shape #" << i << std::endl;
+				continue;
+			}
+
+			if (s["type"] == "compound")
+			{
+				if (!s.contains("children"))
+				{
+					std::cerr << "No children in shape #" << i << std::endl;
+					continue;
+				}
+
+				auto compound = std::make_unique<physics::compound_shape>();
+				for (auto &c : s["children"])
+				{
+					if (!c.contains("shape") || shapes.find(c["shape"]) == shapes.end())
+					{
+						std::cerr << "Unknown child shape in shape #" << i << std::endl;
+						continue;
+					}
+
+					glm::vec2 pos{};
+					if (c.contains("pos"))
+						pos = {c["pos"][0], c["pos"][1]};
+
+					glm::vec2 scale{1, 1};
+					if (c.contains("scale"))
+						scale = {c["scale"][0], c["scale"][1]};
+
+					float angle = 0;
+					if (c.contains("angle"))
+						angle = glm::radians((float)c["angle"]);
+
+					compound->add_child(*shapes[c["shape"]], pos, scale, angle);
+				}
+
+				shapes.insert({s["name"], compound.get()});
+				custom_shapes.push_back(std::move(compound));
+			}
+			else if (s["type"] == "polygon")
+			{
+				if (!s.contains("points"))
+				{
+					std::cerr << "No points in shape #" << i << std::endl;
+					continue;
+				}
+
+				std::vector<glm::vec2> points;
+				for (auto &pt : s["points"])
+					points.push_back({pt[0], pt[1]});
+
+				// vertices closer than this to the line through their neighbors are merged
+				float tolerance = 0;
+				if (s.contains("tolerance"))
+					tolerance = s["tolerance"];
+
+				auto outline = physics::remove_collinear(points, tolerance);
+				if (outline.size() < 3)
+				{
+					std::cerr << "Degenerate polygon in shape #" << i << std::endl;
+					continue;
+				}
+
+				// concave outlines are split into convex pieces, once per distinct outline
+				if (physics::is_convex(outline))
+				{
+					if (physics::signed_area(outline) < 0)
+						std::reverse(outline.begin(), outline.end());
+
+					auto poly = std::make_unique<physics::polygon<physics::dynamic_size>>(outline);
+					shapes.insert({s["name"], poly.get()});
+					custom_shapes.push_back(std::move(poly));
+				}
+				else
+					shapes.insert({s["name"], &decompositions.get(points, tolerance)});
+			}
+			else if (s["type"] == "capsule" || s["type"] == "rounded_box" || s["type"] == "rounded_polygon")
+			{
+				if (!s.contains("radius"))
+				{
+					std::cerr << "No radius in shape #" << i << std::endl;
+					continue;
+				}
+
+				float radius = s["radius"];
+				std::unique_ptr<physics::rounded_shape> rounded;
+
+				if (s["type"] == "capsule")
+				{
+					if (!s.contains("half_length"))
+					{
+						std::cerr << "No half_length in shape #" << i << std::endl;
+						continue;
+					}
+
+					rounded = std::make_unique<physics::rounded_shape>(physics::make_capsule(s["half_length"], radius));
+				}
+				else if (s["type"] == "rounded_box")
+				{
+					if (!s.contains("half_extents"))
+					{
+						std::cerr << "No half_extents in shape #" << i << std::endl;
+						continue;
+					}
+
+					glm::vec2 half_extents{s["half_extents"][0], s["half_extents"][1]};
+					rounded = std::make_unique<physics::rounded_shape>(physics::make_rounded_box(half_extents, radius));
+				}
+				else
+				{
+					if (!s.contains("points"))
+					{
+						std::cerr << "No points in shape #" << i << std::endl;
+						continue;
+					}
+
+					std::vector<glm::vec2> points;
+					for (auto &pt : s["points"])
+						points.push_back({pt[0], pt[1]});
+
+					if (!physics::is_convex(points))
+					{
+						std::cerr << "Rounded polygon must be convex in shape #" << i << std::endl;
+						continue;
+					}
+
+					rounded = std::make_unique<physics::rounded_shape>(physics::make_rounded_polygon(points, radius));
+				}
+
+				shapes.insert({s["name"], rounded.get()});
+				custom_shapes.push_back(std::move(rounded));
+			}
+			else if (s["type"] == "chain")
+			{
+				if (!s.contains("points"))
+				{
+					std::cerr << "No points in shape #" << i << std::endl;
+					continue;
+				}
+
+				std::vector<glm::vec2> points;
+				for (auto &pt : s["points"])
+					points.push_back({pt[0], pt[1]});
+
+				if (points.size() < 2)
+				{
+					std::cerr << "Chain needs at least two points in shape #" << i << std::endl;
+					continue;
+				}
+
+				bool loop = s.contains("loop") && s["loop"];
+				float thickness = 1;
+				if (s.contains("thickness"))
+					thickness = s["thickness"];
+
+				auto chain = std::make_unique<physics::chain_shape>(points, loop, thickness);
+				shapes.insert({s["name"], chain.get()});
+				custom_shapes.push_back(std::move(chain));
+			}
+			else if (s["type"] == "heightfield")
+			{
+				if (!s.contains("heights") || !s.contains("spacing"))
+				{
+					std::cerr << "No heights or spacing in shape #" << i << std::endl;
+					continue;
+				}
+
+				std::vector<float> heights;
+				for (auto &h : s["heights"])
+					heights.push_back(h);
+
+				float thickness = 1;
+				if (s.contains("thickness"))
+					thickness = s["thickness"];
+
+				auto heightfield = std::make_unique<physics::heightfield_shape>(heights, s["spacing"], thickness);
+				shapes.insert({s["name"], heightfield.get()});
+				custom_shapes.push_back(std::move(heightfield));
+			}
+			else if (s["type"] == "hull")
+			{
+				if (!s.contains("points"))
+				{
+					std::cerr << "No points in shape #" << i << std::endl;
+					continue;
+				}
+
+				std::vector<glm::vec2> points;
+				for (auto &pt : s["points"])
+					points.push_back({pt[0], pt[1]});
+
+				// how far the simplified hull may be from the original hull
+				float tolerance = 0;
+				if (s.contains("tolerance"))
+					tolerance = s["tolerance"];
+
+				physics::hull_stats stats;
+				auto hull = std::make_unique<physics::polygon<physics::dynamic_size>>(physics::make_hull(points, tolerance, &stats));
+				if (hull->size() < 3)
+				{
+					std::cerr << "Degenerate hull in shape #" << i << std::endl;
+					continue;
+				}
+
+				std::cout << "Hull " << s["name"] << ": support cost " << stats.input_points << " -> " << stats.output_points
+						  << " vertices (hull " << stats.hull_points << ", error " << stats.error << ")\n";
+
+				shapes.insert({s["name"], hull.get()});
+				custom_shapes.push_back(std::move(hull));
+			}
+			else
+			{
+				std::cerr << "Unknown shape type: " << s["type"] << std::endl;
+				continue;
+			}
+		}
+	}
 
 	std::unordered_map<std::string, physics::object *> objects;
 
@@ -155,20 +491,18 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 				continue;
 			}
 
-			physics::polygon *p = nullptr;
+			const physics::abstract_shape *p = nullptr;
 
 			if (o.contains("shape"))
 			{
-				if (o["shape"] == "triangle")
-					p = &triangle;
-				else if (o["shape"] == "pentagon")
-					p = &pentagon;
-				else if (o["shape"] == "rectangle")
-					p = &rect;
-				else if (o["shape"] == "circle")
-					p = &circle;
-				else if (o["shape"] == "hexagon")
-					p = &hexagon;
+				auto shape = shapes.find(o["shape"]);
+				if (shape == shapes.end())
+				{
+					std::cerr << "Unknown shape: " << o["shape"] << std::endl;
+					continue;
+				}
+
+				p = shape->second;
 			}
 			else
 			{
@@ -206,6 +540,14 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 			else
 				color = {0, 0, 0, 1};
 
+			physics::collision_filter filter;
+			if (o.contains("category"))
+				filter.category = o["category"];
+			if (o.contains("mask"))
+				filter.mask = o["mask"];
+			if (o.contains("group"))
+				filter.group = o["group"];
+
 			enum class object_type { dynamic, static_type };
 			object_type type;
 			if (o.contains("type"))
@@ -246,10 +588,17 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 				else
 					mass = 1;
 
-				loc->second = res.add_object(*p, pos, vel, angle, w, mass, scale);
+				loc->second = res.add_object(*p, pos, vel, angle, w, mass, scale, filter);
 			}
 			else
-				loc->second = res.add_static_object(*p, pos, angle, scale);
+				loc->second = res.add_static_object(*p, pos, angle, scale, filter);
+
+			if (o.contains("sensor"))
+				loc->second->sensor = o["sensor"];
+			if (o.contains("friction"))
+				loc->second->friction = o["friction"];
+			if (o.contains("restitution"))
+				loc->second->restitution = o["restitution"];
 
 			world_drawer.add_object(loc->second, color);
 		}
@@ -296,7 +645,7 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 							continue;
 						}
 
-						res.add_constraint(std::make_unique<physics::position_constraint>(*obj1->second, *obj2->second, dist));
+						res.add_position_constraint(*obj1->second, *obj2->second, dist, c.value("compliance", 0.f));
 					}
 					else
 					{
@@ -337,7 +686,7 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 							continue;
 						}
 
-						res.add_constraint(std::make_unique<physics::rope_constraint>(*obj1->second, *obj2->second, dist));
+						res.add_rope_constraint(*obj1->second, *obj2->second, dist, c.value("compliance", 0.f));
 					}
 					else
 					{
@@ -345,6 +694,84 @@ physics::world parse_json(const char *filename, drawer &world_drawer)
 						continue;
 					}
 				}
+				else if (c["type"] == "revolute" || c["type"] == "prismatic" || c["type"] == "weld" || c["type"] == "motor")
+				{
+					if (!c.contains("objects") || c["objects"].size() != 2)
+					{
+						std::cerr << "Joint #" << i << " must have two objects" << std::endl;
+						continue;
+					}
+
+					auto obj1 = objects.find(c["objects"][0]);
+					auto obj2 = objects.find(c["objects"][1]);
+
+					if (obj1 == objects.end())
+					{
+						std::cerr << "Object " << c["objects"][0] << " not found" << std::endl;
+						continue;
+					}
+					if (obj2 == objects.end())
+					{
+						std::cerr << "Object " << c["objects"][1] << " not found" << std::endl;
+						continue;
+					}
+
+					physics::object &a = *obj1->second, &b = *obj2->second;
+
+					// the anchor defaults to the position of the second object
+					glm::vec2 anchor = b.pt.pos;
+					if (c.contains("anchor"))
+						anchor = {c["anchor"][0], c["anchor"][1]};
+
+					if (c["type"] == "revolute")
+					{
+						auto &j = *res.find_constraint<physics::revolute_joint>(res.add_revolute_joint(a, b, anchor));
+						if (c.contains("limits"))
+						{
+							j.limit = true;
+							j.lower_angle = glm::radians((float)c["limits"][0]);
+							j.upper_angle = glm::radians((float)c["limits"][1]);
+						}
+						if (c.contains("motor_speed"))
+						{
+							j.motor = true;
+							j.motor_speed = c["motor_speed"];
+							j.max_motor_torque = c.value("max_motor_torque", 0.f);
+						}
+					}
+					else if (c["type"] == "prismatic")
+					{
+						if (!c.contains("axis"))
+						{
+							std::cerr << "No axis in constraint #" << i << std::endl;
+							continue;
+						}
+
+						auto &j = *res.find_constraint<physics::prismatic_joint>(res.add_prismatic_joint(a, b, anchor, {c["axis"][0], c["axis"][1]}));
+						if (c.contains("limits"))
+						{
+							j.limit = true;
+							j.lower_translation = c["limits"][0];
+							j.upper_translation = c["limits"][1];
+						}
+						if (c.contains("motor_speed"))
+						{
+							j.motor = true;
+							j.motor_speed = c["motor_speed"];
+							j.max_motor_force = c.value("max_motor_force", 0.f);
+						}
+					}
+					else if (c["type"] == "weld")
+						res.add_weld_joint(a, b, anchor);
+					else
+					{
+						auto &j = *res.find_constraint<physics::motor_joint>(res.add_motor_joint(a, b, c.value("max_force", 0.f), c.value("max_torque", 0.f)));
+						if (c.contains("offset"))
+							j.linear_offset = {c["offset"][0], c["offset"][1]};
+						if (c.contains("angle"))
+							j.angular_offset = glm::radians((float)c["angle"]);
+					}
+				}
 				else
 				{
 					std::cerr << "Unknown constraint type: " << c["type"] << std::endl;
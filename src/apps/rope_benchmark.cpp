@@ -0,0 +1,143 @@
+#include "world.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+
+// a net of about 100k rope links hanging from its top row, solved with the scalar and the simd constraint updates
+// first the update alone on gathered bodies, then whole world steps
+
+constexpr int net_size = 224; // nodes per side, 2 * 224 * 223 links
+constexpr float spacing = .5f;
+
+struct net
+{
+	std::vector<physics::solver_body> bodies;
+	std::vector<glm::vec2> positions;
+	std::vector<physics::rope_constraint> links;
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> colors; // ranges of links
+};
+
+static net make_net()
+{
+	net res;
+	for (int y = 0; y < net_size; ++y)
+		for (int x = 0; x < net_size; ++x)
+		{
+			bool fixed = y == net_size - 1;
+			// a bit of stretch and motion so the constraints have work to do
+			res.positions.push_back({x * spacing * 1.01f, y * spacing * 1.01f});
+			res.bodies.push_back({{std::sin(x * .1f), std::cos(y * .1f)}, 0, fixed ? 0 : 10.f, 0});
+		}
+
+	auto id = [](int x, int y) { return static_cast<std::uint32_t>(y * net_size + x); };
+	for (int y = 0; y < net_size; ++y)
+		for (int x = 0; x < net_size; ++x)
+		{
+			if (x + 1 < net_size)
+				res.links.push_back({id(x, y), id(x + 1, y), spacing});
+			if (y + 1 < net_size)
+				res.links.push_back({id(x, y), id(x, y + 1), spacing});
+		}
+
+	physics::graph_coloring coloring;
+	coloring.reset(res.bodies.size());
+	for (auto &c : res.links)
+		c.color = coloring.add(c.a, c.b, res.bodies[c.a].inv_m == 0, res.bodies[c.b].inv_m == 0);
+	std::stable_sort(res.links.begin(), res.links.end(), [](const auto &l, const auto &r) { return l.color < r.color; });
+
+	for (std::uint32_t i = 0; i < res.links.size(); ++i)
+		if (i == 0 || res.links[i].color != res.links[i - 1].color)
+			res.colors.push_back({i, i + 1});
+		else
+			res.colors.back().second = i + 1;
+
+	return res;
+}
+
+// runs passes over every color and returns the time per link in ns
+static double time_update(net &n, bool simd, int passes)
+{
+	std::span<const physics::rope_constraint> links(n.links);
+	physics::solver_settings settings;
+	float bias_rate = physics::make_softness(settings.joint_hertz, settings.joint_damping_ratio, settings.time_step).bias_rate;
+
+	auto begin = std::chrono::steady_clock::now();
+	for (int p = 0; p < passes; ++p)
+		for (auto [first, last] : n.colors)
+		{
+			if (simd)
+				physics::update_constraints_wide(n.bodies, n.positions, links.subspan(first, last - first), bias_rate);
+			else
+				physics::update_constraints(n.bodies, n.positions, links.subspan(first, last - first), bias_rate);
+		}
+	auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin);
+
+	return elapsed.count() / passes / n.links.size();
+}
+
+// whole steps of a world holding the net, the nodes don't collide so the ropes are most of the work
+static double time_world(bool simd, int steps, glm::vec2 &bottom)
+{
+	static auto circle = physics::make_regular<8>();
+
+	physics::world w(net_size * spacing + 2, net_size * spacing * 2, -10);
+	w.settings().simd = simd;
+	w.settings().sleeping = false;
+
+	physics::collision_filter no_collisions{1, 0, 0};
+	std::vector<physics::object *> nodes;
+	for (int y = 0; y < net_size; ++y)
+		for (int x = 0; x < net_size; ++x)
+		{
+			glm::vec2 pos{1 + x * spacing, net_size * spacing + y * spacing * .99f};
+			if (y == net_size - 1)
+				nodes.push_back(w.add_static_object(circle, pos, 0, {.05f, .05f}, no_collisions));
+			else
+				nodes.push_back(w.add_object(circle, pos, {}, 0, 0, .1f, {.05f, .05f}, no_collisions));
+		}
+
+	for (int y = 0; y < net_size; ++y)
+		for (int x = 0; x < net_size; ++x)
+		{
+			if (x + 1 < net_size)
+				w.add_rope_constraint(*nodes[y * net_size + x], *nodes[y * net_size + x + 1], spacing);
+			if (y + 1 < net_size)
+				w.add_rope_constraint(*nodes[y * net_size + x], *nodes[(y + 1) * net_size + x], spacing);
+		}
+
+	// the first steps color and sort the constraints
+	w.update(2 * w.step_length());
+
+	auto begin = std::chrono::steady_clock::now();
+	w.update(steps * w.step_length());
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin);
+
+	bottom = nodes[net_size / 2]->pt.pos;
+	return elapsed.count() / w.stats().steps;
+}
+
+int main()
+{
+	std::cout << "lanes: " << physics::wide_lanes << '\n';
+
+	net scalar = make_net(), wide = scalar;
+	std::cout << "links: " << scalar.links.size() << ", colors: " << scalar.colors.size() << '\n';
+
+	double scalar_ns = time_update(scalar, false, 100);
+	double wide_ns = time_update(wide, true, 100);
+
+	float max_diff = 0;
+	for (std::size_t i = 0; i < scalar.bodies.size(); ++i)
+		max_diff = std::max(max_diff, glm::length(scalar.bodies[i].v - wide.bodies[i].v));
+
+	std::cout << std::setprecision(3) << "update, scalar: " << scalar_ns << " ns/link, simd: " << wide_ns << " ns/link, speedup: " << scalar_ns / wide_ns
+			  << ", largest velocity difference: " << max_diff << '\n';
+
+	glm::vec2 scalar_bottom, wide_bottom;
+	double scalar_ms = time_world(false, 20, scalar_bottom);
+	double wide_ms = time_world(true, 20, wide_bottom);
+	std::cout << "world step, scalar: " << scalar_ms << " ms, simd: " << wide_ms << " ms, bottom node moved apart by "
+			  << glm::length(scalar_bottom - wide_bottom) << '\n';
+}
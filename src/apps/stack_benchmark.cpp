@@ -0,0 +1,113 @@
+#include "world.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+// builds tall stacks of boxes and finds the fewest velocity iterations that keep them standing
+// a stack is stable if its top box hasn't slid, tipped or sunk and nothing moved during the last second
+// the global solver counts its passes over the assembled system as iterations
+// shock runs the block solver followed by a shock propagation pass
+
+enum class stack_solver
+{
+	sequential,
+	block,
+	global,
+	shock
+};
+
+struct stack_result
+{
+	bool stable;
+	float drift; // how far the top box slid or sank, in box sizes
+	float max_speed; // over the last second
+	double step_us;
+};
+
+static stack_result run_stack(int height, int iterations, stack_solver solver)
+{
+	constexpr float seconds = 4;
+	constexpr float frame = 1.f / 60;
+
+	static auto box = physics::make_regular<4>();
+	physics::shape_view view(box, {0, 0}, {1, 1}, 0);
+	float size = view.bounds().max.y - view.bounds().min.y;
+
+	physics::world w(24, size * height + 10, -25);
+	w.settings().velocity_iterations = iterations;
+	w.settings().global_iterations = iterations;
+	// the iterations under test are run even once the stack is quiet
+	w.settings().residual_tolerance = 0;
+	w.settings().block_solver = solver == stack_solver::block || solver == stack_solver::shock;
+	w.settings().shock_propagation = solver == stack_solver::shock;
+	if (solver == stack_solver::global)
+		w.settings().mode = physics::solver_mode::global;
+	// a stack that falls asleep would look stable and cost nothing
+	w.settings().sleeping = false;
+
+	// boxes that just touch have no contact yet, the stack would fall into itself before it is found
+	float spacing = size - physics::contact_slop / 2;
+	std::vector<physics::object *> stack;
+	for (int i = 0; i < height; ++i)
+		stack.push_back(w.add_object(box, {12, size / 2 + i * spacing}, {}, 0, 0, 1, {1, 1}));
+
+	glm::vec2 top_touching{12, size / 2 + (height - 1) * size};
+
+	stack_result res{};
+
+	std::size_t steps = 0;
+	auto begin = std::chrono::steady_clock::now();
+	for (float t = 0; t < seconds; t += frame)
+	{
+		w.update(frame);
+		steps += w.stats().steps;
+
+		if (t >= seconds - 1)
+			for (auto obj : stack)
+				res.max_speed = std::max(res.max_speed, glm::length(obj->pt.v) + std::abs(obj->pt.w) * size);
+	}
+	auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin);
+
+	res.step_us = elapsed.count() / steps;
+	// every contact may be left overlapping by up to the slop, so the top box can settle that much per box without sinking
+	glm::vec2 moved = stack.back()->pt.pos - top_touching;
+	float sink = std::max(-moved.y - height * physics::contact_slop, 0.f) + std::max(moved.y, 0.f);
+	res.drift = glm::length(glm::vec2{moved.x, sink}) / size;
+
+	res.stable = res.drift < .05f && res.max_speed < .05f && std::abs(stack.back()->pt.angle) < .05f;
+	return res;
+}
+
+int main()
+{
+	const int heights[] = {5, 10, 20, 30, 40, 100, 200};
+	const int iterations[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64};
+
+	std::cout << std::setw(8) << "height" << std::setw(14) << "solver" << std::setw(12) << "iterations"
+			  << std::setw(10) << "drift" << std::setw(12) << "speed" << std::setw(12) << "us/step" << '\n';
+
+	for (int height : heights)
+		for (auto solver : {stack_solver::sequential, stack_solver::block, stack_solver::global, stack_solver::shock})
+		{
+			stack_result res{};
+			int needed = 0;
+			for (int n : iterations)
+			{
+				res = run_stack(height, n, solver);
+				if (res.stable)
+				{
+					needed = n;
+					break;
+				}
+			}
+
+			const char *names[] = {"sequential", "block", "global", "shock"};
+			std::cout << std::setw(8) << height << std::setw(14) << names[static_cast<int>(solver)];
+			if (needed)
+				std::cout << std::setw(12) << needed;
+			else
+				std::cout << std::setw(12) << "unstable";
+			std::cout << std::setw(10) << std::setprecision(3) << res.drift << std::setw(12) << res.max_speed << std::setw(12) << res.step_us << '\n';
+		}
+}
@@ -0,0 +1,136 @@
+#include "world.h"
+#include "compound.h"
+#include "terrain.h"
+
+#include <array>
+#include <cmath>
+#include <iostream>
+
+// scenes with a known resting state, each run in the impulses and the xpbd mode
+// the exit code is the number of failed checks
+
+static const physics::polygon<4> unit_box(std::array<glm::vec2, 4>{glm::vec2{-.5f, -.5f}, {.5f, -.5f}, {.5f, .5f}, {-.5f, .5f}});
+
+static int failures = 0;
+
+static void check(bool ok, const char *scene, physics::solver_mode mode, const char *what)
+{
+	if (ok)
+		return;
+	++failures;
+	std::cout << scene << (mode == physics::solver_mode::xpbd ? " (xpbd): " : " (impulses): ") << what << std::endl;
+}
+
+// an arch standing on its two legs on a box, both legs have to hold it up
+static void arch_on_box(physics::solver_mode mode)
+{
+	physics::compound_shape arch;
+	arch.add_child(unit_box, {-1, 0}, {.4f, 1}, 0);
+	arch.add_child(unit_box, {1, 0}, {.4f, 1}, 0);
+	arch.add_child(unit_box, {0, .6f}, {2.4f, .2f}, 0);
+
+	physics::world w(24, 20, -25);
+	w.settings().mode = mode;
+	w.settings().sleeping = false;
+	w.add_static_object(unit_box, {12, 1}, 0, {10, 2});
+	// dropped slightly tilted, so it lands on one leg first
+	auto *obj = w.add_object(arch, {12, 2.7f}, {}, .05f, 0, 1, {1, 1});
+
+	float max_speed = 0;
+	float lowest = obj->pt.pos.y;
+	for (int frame = 0; frame < 180; ++frame)
+	{
+		w.update(1.f / 60);
+		if (frame >= 120)
+		{
+			max_speed = std::max(max_speed, glm::length(obj->pt.v) + std::abs(obj->pt.w));
+			lowest = std::min(lowest, obj->pt.pos.y);
+		}
+	}
+
+	std::vector<physics::collision> manifolds;
+	physics::collides(physics::shape_view(arch, obj->pt.pos, {1, 1}, obj->pt.angle), physics::shape_view(unit_box, {12, 1}, {10, 2}, 0), manifolds);
+	check(manifolds.size() == 2, "arch on box", mode, "each leg should have a manifold");
+	check(max_speed < 1e-3f, "arch on box", mode, "still moving after two seconds");
+	check(lowest > 2.5f - 2 * physics::contact_slop, "arch on box", mode, "sank into the box");
+}
+
+// small boxes dropped along bumpy ground, each straddles a few segments once it settles and has to come to rest there
+static void boxes_on_terrain(physics::solver_mode mode, const char *scene, const physics::abstract_shape &ground)
+{
+	int moving = 0;
+	for (float x = 1; x < 11; x += .5f)
+	{
+		physics::world w(12, 10, -25);
+		w.settings().mode = mode;
+		w.settings().sleeping = false;
+		// restitution mixes as the larger of the two, so neither bounces
+		w.add_static_object(ground, {0, 0}, 0, {1, 1})->restitution = 0;
+		auto *obj = w.add_object(unit_box, {x, 3}, {}, 0, 0, 1, {.5f, .5f});
+		obj->friction = 1;
+		obj->restitution = 0;
+		// add_object gives the inertia of a much larger body, which keeps rocking for a long time
+		obj->pt.I = (.5f * .5f + .5f * .5f) / 12;
+
+		float max_speed = 0;
+		for (int frame = 0; frame < 300; ++frame)
+		{
+			w.update(1.f / 60);
+			if (frame >= 240)
+				max_speed = std::max(max_speed, glm::length(obj->pt.v) + std::abs(obj->pt.w));
+		}
+		moving += max_speed > 1e-2f;
+	}
+	check(moving == 0, scene, mode, "boxes still moving after four seconds");
+}
+
+// a box whose top is just under the ground, as if it went through in one step, has to be pushed back up onto it
+// without ground it's the floor of the world's boundary
+static void box_under_ground(physics::solver_mode mode, const char *scene, const physics::abstract_shape *ground, float surface)
+{
+	physics::world w(12, 10, -25);
+	w.settings().mode = mode;
+	w.settings().sleeping = false;
+	if (ground)
+		w.add_static_object(*ground, {0, 0}, 0, {1, 1})->restitution = 0;
+	auto *obj = w.add_object(unit_box, {6, surface - .3f}, {}, 0, 0, 1, {.5f, .5f});
+	obj->restitution = 0;
+
+	for (int frame = 0; frame < 120; ++frame)
+		w.update(1.f / 60);
+
+	check(obj->pt.pos.y > surface + .25f - 2 * physics::contact_slop, scene, mode, "not pushed back up");
+	check(obj->pt.pos.y < surface + .5f, scene, mode, "thrown up");
+}
+
+int main()
+{
+	std::vector<float> heights;
+	std::vector<glm::vec2> points;
+	for (int i = 0; i <= 60; ++i)
+	{
+		float x = i * .2f;
+		heights.push_back(1 + .3f * std::sin(x * 1.3f) + .1f * std::sin(x * 4.1f));
+		points.push_back({x, heights.back()});
+	}
+	physics::heightfield_shape heightfield(heights, .2f);
+	physics::chain_shape chain(points, false);
+
+	std::vector<float> flat_heights(13, 1.f);
+	physics::heightfield_shape flat_heightfield(flat_heights, 1.f);
+	physics::chain_shape flat_chain({glm::vec2{0, 1}, {12, 1}}, false);
+
+	for (auto mode : {physics::solver_mode::impulses, physics::solver_mode::xpbd})
+	{
+		arch_on_box(mode);
+		boxes_on_terrain(mode, "boxes on heightfield", heightfield);
+		boxes_on_terrain(mode, "boxes on chain", chain);
+		box_under_ground(mode, "box under heightfield", &flat_heightfield, 1);
+		box_under_ground(mode, "box under chain", &flat_chain, 1);
+		box_under_ground(mode, "box under the world's floor", nullptr, 0);
+	}
+
+	if (failures == 0)
+		std::cout << "all passed" << std::endl;
+	return failures;
+}
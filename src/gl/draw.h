@@ -2,7 +2,10 @@
 #define DRAW_H
 
 #include "bound.h"
+#include "compound.h"
+#include "terrain.h"
 #include "object.h"
+#include "world.h"
 
 #include <unordered_map>
 #include <memory>
@@ -62,7 +65,13 @@ private:
 class draw_shape
 {
 public:
-	virtual void draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec2 scale, float angle) const = 0;
+	void draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec2 scale, float angle) const
+	{
+		draw_model(gl, color, glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), {pos, 0}), angle, {0, 0, 1}), {scale, 0}));
+	}
+
+	// model is translate * rotate * scale of the shape
+	virtual void draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const = 0;
 	virtual ~draw_shape() = default;
 };
 
@@ -81,7 +90,7 @@ public:
 	draw_poly(draw_poly &&) = default;
 	draw_poly &operator=(draw_poly &&) = default;
 
-	void draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec2 scale, float angle) const override;
+	void draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const override;
 
 private:
 	std::size_t m_size;
@@ -91,15 +100,61 @@ private:
 	void init(const glm::vec2 *data);
 };
 
+// connected line segments, closed if loop
+class draw_lines : public draw_shape
+{
+public:
+	template <std::ranges::contiguous_range R>
+	draw_lines(R &&points, bool loop) : m_size{std::ranges::size(points)}, m_loop{loop}
+	{
+		init(std::ranges::data(points));
+	}
+
+	draw_lines(const draw_lines &) = delete;
+	draw_lines &operator=(const draw_lines &) = delete;
+
+	draw_lines(draw_lines &&) = default;
+	draw_lines &operator=(draw_lines &&) = default;
+
+	void draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const override;
+
+private:
+	std::size_t m_size;
+	bool m_loop;
+	vao m_vao;
+	vbo m_vbo;
+
+	void init(const glm::vec2 *data);
+};
+
 // radius 1, so the scale passed to draw is the radius
 class draw_circle : public draw_shape
 {
 public:
 	draw_circle() = default;
 
-	void draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec2 scale, float angle) const override;
+	void draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const override;
 };
 
+inline std::unique_ptr<draw_shape> make_shape(const physics::abstract_shape &shape);
+
+// draws each child of a compound_shape with its local transform
+class draw_compound : public draw_shape
+{
+public:
+	draw_compound(const physics::compound_shape &shape);
+
+	void draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const override;
+
+private:
+	struct child
+	{
+		std::unique_ptr<draw_shape> shape;
+		glm::mat4 model;
+	};
+
+	std::vector<child> m_children;
+};
 
 inline std::unique_ptr<draw_shape> make_shape(const physics::abstract_shape &shape)
 {
@@ -107,6 +162,32 @@ inline std::unique_ptr<draw_shape> make_shape(const physics::abstract_shape &sha
 		return std::make_unique<draw_poly>(std::span<const glm::vec2>(shape_poly->data(), shape_poly->size()));
 	else if (auto shape_circle = dynamic_cast<const physics::circle *>(&shape))
 		return std::make_unique<draw_circle>();
+	else if (auto shape_compound = dynamic_cast<const physics::compound_shape *>(&shape))
+		return std::make_unique<draw_compound>(*shape_compound);
+	else if (auto shape_chain = dynamic_cast<const physics::chain_shape *>(&shape))
+		return std::make_unique<draw_lines>(shape_chain->points(), shape_chain->loop());
+	else if (auto shape_heightfield = dynamic_cast<const physics::heightfield_shape *>(&shape))
+	{
+		std::vector<glm::vec2> points;
+		points.reserve(shape_heightfield->size());
+		for (physics::length_type i = 0; i < shape_heightfield->size(); ++i)
+			points.push_back({shape_heightfield->spacing() * i, shape_heightfield->height(i)});
+		return std::make_unique<draw_lines>(points, false);
+	}
+	else if (shape.rounded())
+	{
+		// outline sampled from the support function, the corners of the core become arcs
+		constexpr int samples = 64;
+		physics::shape_view view(shape);
+		std::vector<glm::vec2> outline;
+		outline.reserve(samples);
+		for (int i = 0; i < samples; ++i)
+		{
+			float angle = 2 * glm::pi<float>() * i / samples;
+			outline.push_back(view.support({std::cos(angle), std::sin(angle)}));
+		}
+		return std::make_unique<draw_poly>(outline);
+	}
 	else
 		return {};
 }
@@ -122,10 +203,20 @@ public:
 		objects.push_back({obj, color, it->second.get()});
 	}
 
-	void draw(gl_instance &gl) const
+	// draws the objects between their transforms before and after the last step of the world
+	// poses changed outside of the steps only show if they went through world::set_transform
+	void draw(gl_instance &gl, const physics::world &w) const
 	{
+		auto prev = w.previous_transforms();
+		auto cur = w.current_transforms();
+		float alpha = w.interpolation_alpha();
 		for (const auto &obj : objects)
-			obj.drawable_shape->draw(gl, obj.color, obj.obj->pt.pos, obj.obj->scale, obj.obj->pt.angle);
+		{
+			auto id = obj.obj->id;
+			glm::vec2 pos = prev.positions[id] + (cur.positions[id] - prev.positions[id]) * alpha;
+			float angle = prev.angles[id] + (cur.angles[id] - prev.angles[id]) * alpha;
+			obj.drawable_shape->draw(gl, obj.color, pos, obj.obj->scale, angle);
+		}
 	}
 
 private:
@@ -0,0 +1,97 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <cstdint>
+#include <cassert>
+
+#include "bound.h"
+
+PHYSICS_BEG
+
+// dynamic bounding volume hierarchy of axis aligned boxes
+// leaves are inserted where they grow the tree the least and the tree is kept balanced with rotations
+class aabb_tree
+{
+public:
+	using proxy = std::uint32_t;
+	static constexpr proxy null_proxy = std::numeric_limits<proxy>::max();
+
+	// boxes are fattened by margin so small movements don't need a reinsert
+	aabb_tree(float margin = 0) : m_root{null_proxy}, m_free{null_proxy}, m_margin{margin} {}
+
+	proxy insert(const bounding_box &box, std::uint32_t data);
+	void remove(proxy id);
+
+	// reinserts the proxy if box left its fattened bounds, returns true if it was reinserted
+	bool move(proxy id, const bounding_box &box);
+
+	void clear();
+
+	bool empty() const { return m_root == null_proxy; }
+	const bounding_box &bounds() const { return m_nodes[m_root].box; }
+	const bounding_box &bounds(proxy id) const { return m_nodes[id].box; }
+	std::uint32_t data(proxy id) const { return m_nodes[id].data; }
+	int height() const { return m_root == null_proxy ? 0 : m_nodes[m_root].height; }
+
+	// calls f(data) for every leaf whose box overlaps box
+	template <typename F>
+	void query(const bounding_box &box, F &&f) const
+	{
+		if (m_root == null_proxy)
+			return;
+
+		// the tree is balanced, so the stack only grows with the height
+		proxy stack[max_height];
+		int top = 0;
+		stack[top++] = m_root;
+
+		while (top)
+		{
+			const node &n = m_nodes[stack[--top]];
+			if (!n.box.overlaps(box))
+				continue;
+
+			if (n.leaf())
+				f(n.data);
+			else
+			{
+				assert(top + 2 <= max_height);
+				stack[top++] = n.left;
+				stack[top++] = n.right;
+			}
+		}
+	}
+
+private:
+	static constexpr int max_height = 128;
+
+	struct node
+	{
+		bounding_box box;
+		proxy parent; // next free node when on the free list
+		proxy left, right;
+		std::uint32_t data;
+		int height; // leaves are 0, free nodes are -1
+
+		bool leaf() const { return left == null_proxy; }
+	};
+
+	std::vector<node> m_nodes;
+	proxy m_root;
+	proxy m_free;
+	float m_margin;
+
+	proxy allocate();
+	void release(proxy id);
+
+	void insert_leaf(proxy leaf);
+	void remove_leaf(proxy leaf);
+
+	// refits boxes and heights from id up to the root, rebalancing on the way
+	void refit(proxy id);
+	proxy balance(proxy id);
+};
+
+PHYSICS_END
+
+#endif
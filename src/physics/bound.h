@@ -8,6 +8,8 @@
 #include <optional>
 #include <vector>
 #include <array>
+#include <memory>
+#include <cstdint>
 
 #include <ranges>
 
@@ -45,9 +47,30 @@ inline glm::vec2 rotate(glm::vec2 v, float angle)
 	return res;
 }
 
+inline float cross(glm::vec2 a, glm::vec2 b) { return a.x * b.y - a.y * b.x; }
+// angular velocity w crossed with r
+inline glm::vec2 cross(float w, glm::vec2 r) { return {-w * r.y, w * r.x}; }
+
 struct bounding_box
 {
 	glm::vec2 min, max;
+
+	bool overlaps(const bounding_box &other) const
+	{
+		return min.x <= other.max.x && other.min.x <= max.x &&
+			   min.y <= other.max.y && other.min.y <= max.y;
+	}
+
+	bool contains(const bounding_box &other) const
+	{
+		return min.x <= other.min.x && min.y <= other.min.y &&
+			   other.max.x <= max.x && other.max.y <= max.y;
+	}
+
+	float perimeter() const { return 2 * (max.x - min.x + max.y - min.y); }
+
+	bounding_box merge(const bounding_box &other) const { return {glm::min(min, other.min), glm::max(max, other.max)}; }
+	bounding_box fatten(float margin) const { return {min - glm::vec2{margin, margin}, max + glm::vec2{margin, margin}}; }
 };
 
 class shape_view;
@@ -61,8 +84,17 @@ struct collision
 	float dist;
 	bool collides;
 
-	collision() : normal{}, dist{}, collides{} {}
-	collision(glm::vec2 _normal, float _dist, glm::vec2 a_pt, glm::vec2 b_pt) : normal{_normal}, a_contact{a_pt}, b_contact{b_pt}, dist{_dist}, collides{true} {}
+	// contact manifold, points are halfway between the surfaces
+	glm::vec2 points[2];
+	float depths[2];
+	unsigned int point_count;
+
+	// pieces of composite shapes the manifold is between, 0 for convex shapes, see piece_pairs
+	std::uint32_t piece_a = 0, piece_b = 0;
+
+	collision() : normal{}, a_contact{}, b_contact{}, dist{}, collides{}, points{}, depths{}, point_count{} {}
+	collision(glm::vec2 _normal, float _dist, glm::vec2 a_pt, glm::vec2 b_pt) : normal{_normal}, a_contact{a_pt}, b_contact{b_pt}, dist{_dist}, collides{true},
+		points{(a_pt + b_pt) / 2.f}, depths{_dist}, point_count{1} {}
 
 	operator bool() const { return collides; }
 };
@@ -80,11 +112,17 @@ public:
 	virtual glm::vec2 center() const { return {0, 0}; }
 	virtual length_type size() const = 0;
 
+	// true for shapes made of several convex pieces, see abstract_composite
+	virtual bool composite() const { return false; }
+	// true for shapes with a convex radius, see rounded_shape
+	virtual bool rounded() const { return false; }
+
 protected:
 	virtual glm::vec2 support(glm::vec2 dir) const = 0;
 
 	friend collision collides(const shape_view &a, const shape_view &b);
 	friend class shape_view;
+	friend class rounded_shape;
 };
 
 constexpr static int dynamic_size = -1;
@@ -183,6 +221,7 @@ constexpr regular_polygon<_size> make_regular() { return regular_polygon<_size>(
 
 inline regular_polygon<dynamic_size> make_regular(length_type size) { return regular_polygon<dynamic_size>(size); }
 
+// points are assumed to form a convex polygon, see convex_decomposition in geometry.h for concave outlines
 template <length_type _size>
 class polygon : public abstract_polygon
 {
@@ -294,7 +333,99 @@ class circle : public abstract_shape
 public:
 	length_type size() const override { return infinity; }
 protected:
-	glm::vec2 support(glm::vec2 dir) const override { return dir; }
+	glm::vec2 support(glm::vec2 dir) const override
+	{
+		float len = glm::length(dir);
+		return len > 0 ? dir / len : glm::vec2{0, 1};
+	}
+};
+
+// convex core inflated by radius, like a capsule (segment core) or a rounded box
+// collisions where the cores don't overlap are found with a distance query on the cores instead of epa
+// the radius is scaled with the shape, but the fast path needs a uniform scale
+class rounded_shape : public abstract_shape
+{
+public:
+	// make sure core is not destroyed before the rounded shape
+	rounded_shape(const abstract_shape &core, float radius) : m_core{&core}, m_radius{radius}, m_capsule{is_segment(core)} {}
+	// the rounded shape takes ownership of core
+	rounded_shape(std::unique_ptr<abstract_shape> core, float radius) : rounded_shape(*core, radius) { m_owned = std::move(core); }
+
+	length_type size() const override { return m_core->size(); }
+	glm::vec2 center() const override { return m_core->center(); }
+	bool rounded() const override { return true; }
+
+	const abstract_shape &core() const { return *m_core; }
+	float radius() const { return m_radius; }
+	// true if the core is a line segment
+	bool capsule() const { return m_capsule; }
+
+private:
+	const abstract_shape *m_core;
+	std::unique_ptr<abstract_shape> m_owned;
+	float m_radius;
+	bool m_capsule;
+
+	static bool is_segment(const abstract_shape &core)
+	{
+		return core.size() == 2 && dynamic_cast<const abstract_polygon *>(&core);
+	}
+
+protected:
+	glm::vec2 support(glm::vec2 dir) const override
+	{
+		float len = glm::length(dir);
+		return m_core->support(dir) + (len > 0 ? dir * (m_radius / len) : glm::vec2{0, 0});
+	}
+};
+
+// segment from (-half_length, 0) to (half_length, 0) inflated by radius
+inline rounded_shape make_capsule(float half_length, float radius)
+{
+	return {std::make_unique<polygon<2>>(std::initializer_list<glm::vec2>{{-half_length, 0}, {half_length, 0}}), radius};
+}
+
+// box with half_extents inflated by radius, so the outer half extents are half_extents + radius
+inline rounded_shape make_rounded_box(glm::vec2 half_extents, float radius)
+{
+	auto core = std::make_unique<polygon<4>>(std::initializer_list<glm::vec2>{-half_extents, {half_extents.x, -half_extents.y}, half_extents, {-half_extents.x, half_extents.y}});
+	return {std::move(core), radius};
+}
+
+// convex polygon inflated by radius
+template <std::ranges::range R>
+rounded_shape make_rounded_polygon(R &&pts, float radius)
+{
+	return {std::make_unique<polygon<dynamic_size>>(std::forward<R>(pts)), radius};
+}
+
+// shape made of several convex pieces (compound_shape, ...)
+// collides only tests the pieces whose bounds overlap the other shape
+class abstract_composite : public abstract_shape
+{
+public:
+	virtual ~abstract_composite() = default;
+
+	bool composite() const override { return true; }
+
+	// bounds of all pieces in the shape's local space
+	virtual bounding_box bounds() const = 0;
+
+	// true if the pieces are segments that only collide from their left side (as seen from the first point)
+	// the normal of a collision is then the segment's normal, which avoids catching on internal edges
+	// only a body touching nothing but the end of a segment gets its own normal there
+	virtual bool one_sided() const { return false; }
+
+	// how far behind its segments a one sided shape is solid (in the shape's local space)
+	// bodies reaching into that are pushed back out, even once they are past the segment itself
+	virtual float thickness() const { return 0; }
+
+	// appends a view of every piece whose bounds overlap box (in the shape's local space)
+	// the appended views are relative to the composite, not the world, and carry their index
+	virtual void query(const bounding_box &box, std::vector<shape_view> &pieces) const = 0;
+
+	// view of the piece with the given index, relative to the composite, indices are below size()
+	virtual shape_view piece(length_type i) const = 0;
 };
 
 class shape_view
@@ -303,13 +434,19 @@ public:
 	glm::vec2 offset;
 	glm::vec2 scale;
 	const abstract_shape *shape;
+	// set for the pieces of a composite shape, the view is then relative to parent
+	const shape_view *parent;
+	// index of the piece in its composite, see abstract_composite::piece
+	length_type index = 0;
 private:
 	float sin_angle;
 	float cos_angle;
 
 public:
-	shape_view(const abstract_shape &_shape) : offset{}, shape{&_shape}, scale{1.f, 1.f}, sin_angle{0}, cos_angle{1} {}
-	shape_view(const abstract_shape &_shape, glm::vec2 _offset, glm::vec2 _scale, float _angle) : offset{_offset}, shape{&_shape}, scale{_scale}, sin_angle{std::sin(_angle)}, cos_angle{std::cos(_angle)} {}
+	shape_view(const abstract_shape &_shape) : offset{}, scale{1.f, 1.f}, shape{&_shape}, parent{}, sin_angle{0}, cos_angle{1} {}
+	shape_view(const abstract_shape &_shape, glm::vec2 _offset, glm::vec2 _scale, float _angle) : offset{_offset}, scale{_scale}, shape{&_shape}, parent{}, sin_angle{std::sin(_angle)}, cos_angle{std::cos(_angle)} {}
+	// rotation given as the unit vector (cos(angle), sin(angle))
+	shape_view(const abstract_shape &_shape, glm::vec2 _offset, glm::vec2 _scale, glm::vec2 _rotation) : offset{_offset}, scale{_scale}, shape{&_shape}, parent{}, sin_angle{_rotation.y}, cos_angle{_rotation.x} {}
 
 	void angle(float _angle)
 	{
@@ -362,14 +499,111 @@ public:
 		return res;
 	}
 
+	// inverse of transform
+	glm::vec2 inverse_transform(glm::vec2 pt) const
+	{
+		pt -= offset;
+		glm::vec2 res{
+			(cos_angle * pt.x + sin_angle * pt.y) / scale.x,
+			(cos_angle * pt.y - sin_angle * pt.x) / scale.y
+		};
+
+		return res;
+	}
+
+	// world space point to the local space of the shape, through any parents
+	glm::vec2 to_local(glm::vec2 pt) const
+	{
+		return inverse_transform(parent ? parent->to_local(pt) : pt);
+	}
+
+	// local space point of the shape to world space, through any parents
+	glm::vec2 to_world(glm::vec2 pt) const
+	{
+		pt = transform(pt);
+		return parent ? parent->to_world(pt) : pt;
+	}
+
+	// bounding box (in the local space of the shape) of a world space bounding box
+	bounding_box to_local(const bounding_box &box) const
+	{
+		glm::vec2 corners[] = {to_local(box.min), to_local({box.max.x, box.min.y}), to_local(box.max), to_local({box.min.x, box.max.y})};
+		bounding_box res{corners[0], corners[0]};
+		for (auto pt : corners)
+			res = res.merge({pt, pt});
+		return res;
+	}
+
 	glm::vec2 support(glm::vec2 dir) const
 	{
-		return transform(shape->support(dir));
+		return to_world(shape->support(dir_to_local(dir)));
+	}
+
+	// world space bounding box
+	bounding_box bounds() const
+	{
+		if (shape->composite())
+		{
+			auto local = static_cast<const abstract_composite *>(shape)->bounds();
+			glm::vec2 corners[] = {to_world(local.min), to_world({local.max.x, local.min.y}), to_world(local.max), to_world({local.min.x, local.max.y})};
+			bounding_box res{corners[0], corners[0]};
+			for (auto pt : corners)
+				res = res.merge({pt, pt});
+			return res;
+		}
+
+		return {{support({-1, 0}).x, support({0, -1}).y}, {support({1, 0}).x, support({0, 1}).y}};
+	}
+
+private:
+	// world space support direction to the local space of the shape, through any parents
+	// as if transpose(rotate * scale_mat) * dir
+	glm::vec2 dir_to_local(glm::vec2 dir) const
+	{
+		if (parent)
+			dir = parent->dir_to_local(dir);
+
+		glm::vec2 res{
+			scale.x * (cos_angle * dir.x + sin_angle * dir.y),
+			scale.y * (cos_angle * dir.y - sin_angle * dir.x)
+		};
+
+		return res;
 	}
 };
 
 // returns collision with mtv to get a out of b or false if no collision
+// composites only give the deepest collision of their pieces
 collision collides(const shape_view &a, const shape_view &b);
+
+struct piece_pair
+{
+	std::uint32_t a, b;
+};
+
+// pairs of convex pieces of a and b whose bounds come within margin of each other, two convex shapes are the pair {0, 0}
+// a piece is numbered by its index in its composite, the pieces of nested composites by index + size() * the index within it
+void piece_pairs(const shape_view &a, const shape_view &b, float margin, std::vector<piece_pair> &pairs);
+
+// collision of one pair of pieces, its piece_a and piece_b are set to them
+collision collides(const shape_view &a, const shape_view &b, piece_pair pieces);
+
+// appends a collision for every pair of pieces that touch, so composites resting on several pieces keep all their supports
+void collides(const shape_view &a, const shape_view &b, std::vector<collision> &manifolds);
+
+// true if the shapes overlap, cheaper than collides since no mtv is computed
+bool overlaps(const shape_view &a, const shape_view &b);
+
+struct closest_points
+{
+	glm::vec2 a; // closest point on shape "a"
+	glm::vec2 b; // closest point on shape "b"
+	float dist; // 0 if the shapes overlap
+};
+
+// gjk distance query between convex shapes
+closest_points distance(const shape_view &a, const shape_view &b);
+
 float moment_of_inertia(const shape_view &a);
 
 PHYSICS_END
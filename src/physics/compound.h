@@ -0,0 +1,50 @@
+#ifndef COMPOUND_H
+#define COMPOUND_H
+
+#include <memory>
+
+#include "aabb_tree.h"
+
+PHYSICS_BEG
+
+// shape made of convex children, each placed with its own local transform
+// the children are kept in an aabb_tree, so collisions only test the children near the other shape
+class compound_shape : public abstract_composite
+{
+public:
+	compound_shape() = default;
+
+	compound_shape(const compound_shape &) = delete;
+	compound_shape &operator=(const compound_shape &) = delete;
+
+	compound_shape(compound_shape &&) = default;
+	compound_shape &operator=(compound_shape &&) = default;
+
+	// make sure shape is not destroyed before the compound
+	void add_child(const abstract_shape &shape, glm::vec2 offset, glm::vec2 scale, float angle);
+	// the compound takes ownership of shape
+	void add_child(std::unique_ptr<abstract_shape> shape, glm::vec2 offset, glm::vec2 scale, float angle);
+
+	length_type size() const override { return static_cast<length_type>(m_children.size()); }
+	glm::vec2 center() const override { return m_center; }
+
+	const shape_view &child(length_type i) const { return m_children[i]; }
+	const std::vector<shape_view> &children() const { return m_children; }
+
+	bounding_box bounds() const override { return m_tree.bounds(); }
+	void query(const bounding_box &box, std::vector<shape_view> &pieces) const override;
+	shape_view piece(length_type i) const override { return m_children[i]; }
+
+private:
+	std::vector<shape_view> m_children;
+	std::vector<std::unique_ptr<abstract_shape>> m_owned;
+	aabb_tree m_tree;
+	glm::vec2 m_center{0, 0};
+
+protected:
+	glm::vec2 support(glm::vec2 dir) const override;
+};
+
+PHYSICS_END
+
+#endif
@@ -1,62 +1,159 @@
 #ifndef CONSTRAINT_H
 #define CONSTRAINT_H
 
-#include <Eigen/Dense>
+#include <cstdint>
+#include <span>
 #include <vector>
 
-#include "object.h"
+#include "solver.h"
 
 PHYSICS_BEG
 
-class constraint
+enum class constraint_kind : std::uint8_t
 {
-public:
-	static constexpr float factor = .01f;
-	virtual void update(float dt) = 0;
-	virtual ~constraint() = default;
+	position,
+	rope,
+	revolute,
+	prismatic,
+	weld,
+	motor
 };
 
-class position_constraint : public constraint
+constexpr std::size_t constraint_kinds = 6;
+
+// refers to a constraint in world, stays valid until that constraint is removed
+struct constraint_handle
 {
-public:
-	position_constraint(object &object_a, object &object_b, float distance) : a{&object_a}, b{&object_b}, dist{distance}
-	{
-	}
+	constraint_kind kind;
+	std::uint32_t slot;
+	std::uint32_t generation;
+};
 
-	void update(float dt) override;
+// constraints refer to their objects by id and are solved on the gathered solver bodies, a and b can be static
+// color is set by world, compliance is the inverse stiffness in m/N used by the xpbd solver, 0 is rigid
 
-private:
-	object *a, *b;
+// keeps two objects at a certain distance from each other
+struct position_constraint
+{
+	static constexpr constraint_kind kind = constraint_kind::position;
+
+	std::uint32_t a, b;
 	float dist;
+	float compliance = 0;
+	std::uint32_t color = 0;
 };
 
-// constraint that keeps two objects <= a certain distance from each other
-class rope_constraint : public constraint
+// keeps two objects <= a certain distance from each other
+struct rope_constraint
 {
-public:
-	rope_constraint(object &object_a, object &object_b, float distance) : a{&object_a}, b{&object_b}, dist{distance}
-	{
-	}
+	static constexpr constraint_kind kind = constraint_kind::rope;
 
-	void update(float dt) override;
-
-private:
-	object *a, *b;
+	std::uint32_t a, b;
 	float dist;
+	float compliance = 0;
+	std::uint32_t color = 0;
 };
 
-class collision_constraint : public constraint
+// one pass over the constraints in order, positions and bodies are by object id
+// they keep no impulses, so of the softness only the bias rate applies, the velocity per unit of distance error
+void update_constraints(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const position_constraint> constraints, float bias_rate);
+void update_constraints(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const rope_constraint> constraints, float bias_rate);
+
+// constraints per instruction in update_constraints_wide, depends on the instruction set the library is built for
+extern const std::size_t wide_lanes;
+
+// the same with several constraints per instruction, the constraints must not share dynamic bodies, like those of one color
+void update_constraints_wide(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const position_constraint> constraints, float bias_rate);
+void update_constraints_wide(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const rope_constraint> constraints, float bias_rate);
+
+// contiguous array of one type of constraint
+// removing swaps the last constraint into the hole, handles go through slots so they survive that and reordering
+template <typename T>
+class constraint_bucket
 {
 public:
-	collision_constraint(object &object_a, object &object_b) : a{&object_a}, b{&object_b}
+	using value_type = T;
+
+	std::span<T> items() { return m_items; }
+	std::span<const T> items() const { return m_items; }
+	std::size_t size() const { return m_items.size(); }
+
+	constraint_handle add(const T &c)
+	{
+		std::uint32_t slot;
+		if (m_free.empty())
+		{
+			slot = static_cast<std::uint32_t>(m_slots.size());
+			m_slots.push_back({0, 0});
+		}
+		else
+		{
+			slot = m_free.back();
+			m_free.pop_back();
+		}
+
+		m_slots[slot].index = static_cast<std::uint32_t>(m_items.size());
+		m_items.push_back(c);
+		m_slot_of.push_back(slot);
+		return {T::kind, slot, m_slots[slot].generation};
+	}
+
+	bool contains(constraint_handle h) const
+	{
+		return h.kind == T::kind && h.slot < m_slots.size() && m_slots[h.slot].generation == h.generation;
+	}
+
+	T &operator[](constraint_handle h) { return m_items[m_slots[h.slot].index]; }
+	const T &operator[](constraint_handle h) const { return m_items[m_slots[h.slot].index]; }
+
+	// the handle has to be contained
+	void remove(constraint_handle h)
 	{
+		std::uint32_t index = m_slots[h.slot].index;
+
+		m_items[index] = m_items.back();
+		m_slot_of[index] = m_slot_of.back();
+		m_slots[m_slot_of[index]].index = index;
+		m_items.pop_back();
+		m_slot_of.pop_back();
+
+		++m_slots[h.slot].generation;
+		m_free.push_back(h.slot);
+	}
+
+	// moves the constraint at order[i] to i
+	void permute(std::span<const std::uint32_t> order)
+	{
+		m_scratch.clear();
+		m_scratch_slots.clear();
+		for (auto i : order)
+		{
+			m_scratch.push_back(m_items[i]);
+			m_scratch_slots.push_back(m_slot_of[i]);
+		}
+		m_items.swap(m_scratch);
+		m_slot_of.swap(m_scratch_slots);
+
+		for (std::uint32_t i = 0; i < m_slot_of.size(); ++i)
+			m_slots[m_slot_of[i]].index = i;
 	}
 
-	void update(float dt) override;
 private:
-	object *a, *b;
+	struct slot_entry
+	{
+		std::uint32_t index; // in m_items
+		std::uint32_t generation; // bumped on removal, so old handles stop matching
+	};
+
+	std::vector<T> m_items;
+	std::vector<std::uint32_t> m_slot_of; // by item
+	std::vector<slot_entry> m_slots;
+	std::vector<std::uint32_t> m_free;
+
+	std::vector<T> m_scratch;
+	std::vector<std::uint32_t> m_scratch_slots;
 };
 
 PHYSICS_END
 
-#endif
\ No newline at end of file
+#endif
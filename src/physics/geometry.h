@@ -0,0 +1,91 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <span>
+#include <memory>
+#include <unordered_map>
+
+#include "compound.h"
+
+PHYSICS_BEG
+
+// positive for counter clockwise outlines
+float signed_area(std::span<const glm::vec2> outline);
+bool is_convex(std::span<const glm::vec2> outline);
+
+// removes vertices that are within tolerance of the line through their neighbors
+std::vector<glm::vec2> remove_collinear(std::span<const glm::vec2> outline, float tolerance);
+
+// splits a simple (possibly concave) outline into convex pieces, each counter clockwise
+// triangulates by ear clipping, then removes diagonals while the pieces stay convex (Hertel-Mehlhorn),
+// which gives at most 4 times the minimal number of pieces
+// vertices within tolerance of being collinear are merged first
+std::vector<std::vector<glm::vec2>> convex_decomposition(std::span<const glm::vec2> outline, float tolerance = 0);
+
+// compound of polygon<dynamic_size> pieces made from convex_decomposition
+compound_shape make_convex_decomposition(std::span<const glm::vec2> outline, float tolerance = 0);
+
+// counter clockwise convex hull without collinear points (monotone chain)
+std::vector<glm::vec2> convex_hull(std::span<const glm::vec2> points);
+
+// removes the vertices of a counter clockwise convex outline, the one adding the least error first,
+// until removing another would move the outline more than tolerance away from an original vertex
+// keeps removing past tolerance while there are more than max_vertices, and never goes below 3
+// the largest distance of an original vertex from the result is written to error
+std::vector<glm::vec2> simplify_convex(std::span<const glm::vec2> outline, float tolerance,
+	std::size_t max_vertices = std::numeric_limits<std::size_t>::max(), float *error = nullptr);
+
+// support cost is the number of vertices poly_support visits
+struct hull_stats
+{
+	std::size_t input_points;
+	std::size_t hull_points;
+	std::size_t output_points;
+	float error;
+};
+
+// hull of points simplified within tolerance
+polygon<dynamic_size> make_hull(std::span<const glm::vec2> points, float tolerance = 0, hull_stats *stats = nullptr);
+
+// hull of points simplified to at most _size vertices, padded by repeating the last vertex
+template <length_type _size>
+polygon<_size> make_hull(std::span<const glm::vec2> points, float tolerance = 0, hull_stats *stats = nullptr)
+{
+	auto hull = convex_hull(points);
+
+	float error;
+	auto simplified = simplify_convex(hull, tolerance, _size, &error);
+	if (stats)
+		*stats = {points.size(), hull.size(), _size, error};
+
+	while (!simplified.empty() && simplified.size() < _size)
+		simplified.push_back(simplified.back());
+
+	return polygon<_size>(simplified);
+}
+
+// decomposes each distinct outline only once
+class decomposition_cache
+{
+public:
+	// the returned shape lives as long as the cache
+	const compound_shape &get(std::span<const glm::vec2> outline, float tolerance = 0);
+
+	std::size_t size() const { return m_size; }
+	void clear() { m_entries.clear(); m_size = 0; }
+
+private:
+	struct entry
+	{
+		std::vector<glm::vec2> outline;
+		float tolerance;
+		std::unique_ptr<compound_shape> shape;
+	};
+
+	std::unordered_map<std::size_t, std::vector<entry>> m_entries;
+	std::size_t m_size = 0;
+};
+
+PHYSICS_END
+
+#endif
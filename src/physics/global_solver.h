@@ -0,0 +1,86 @@
+#ifndef GLOBAL_SOLVER_H
+#define GLOBAL_SOLVER_H
+
+#include <Eigen/Sparse>
+
+#include <memory>
+
+#include "constraint.h"
+#include "joint.h"
+
+PHYSICS_BEG
+
+// solves the contacts, distance constraints and joints of an island together, as one system of velocity constraints
+// every contact point, friction direction, active distance constraint and joint axis is a row of the sparse jacobian J
+// the rows without bounds, distance constraints and the locked axes of joints, are equalities solved directly
+// with a sparse cholesky factorization of J M^-1 J^T, so a chain holds however long and heavy it is,
+// the bounded rows of contacts, friction, ropes, limits and motors take a projected gauss seidel sweep in between,
+// two point contacts are solved as a block there if the block solver is on
+// https://box2d.org/files/ErinCatto_IterativeDynamics_GDC2005.pdf
+
+// the joints of an island, prepared but not warm started
+struct island_joints
+{
+	std::span<revolute_joint> revolute;
+	std::span<prismatic_joint> prismatic;
+	std::span<weld_joint> weld;
+	std::span<motor_joint> motor;
+};
+
+// buffers of solve_global, kept by the caller so the rows, matrices and factorization are reused from step to step
+struct global_scratch
+{
+	using sparse_matrix = Eigen::SparseMatrix<float, Eigen::RowMajor>;
+
+	// a row of J, its impulse starts from and is written back to impulse if there is one
+	// friction rows are bounded by friction times the impulse of their normal row,
+	// a paired row is bounded together with the row before it, by the length of both impulses
+	struct row
+	{
+		float lo, hi;
+		float *impulse = nullptr;
+		std::int32_t normal_row = -1;
+		float friction = 0;
+		bool paired = false;
+		// set on the first normal row of a contact whose two points are solved together like with the block solver, the second follows it
+		const contact_constraint *block = nullptr;
+	};
+
+	struct block
+	{
+		std::vector<Eigen::Triplet<float>> triplets;
+		std::vector<row> rows;
+		std::vector<float> rhs, diagonal;
+		sparse_matrix jacobian;
+		Eigen::VectorXf lambda;
+		Eigen::VectorXf change; // of the body velocities by the impulses of the block
+	};
+	block equality, bounded;
+
+	Eigen::VectorXf inv_mass, rhs;
+	Eigen::SparseMatrix<float> system; // J M^-1 J^T of the equalities
+	// the factorization can't be copied or moved, the pointer lets the scratch live in a vector
+	std::unique_ptr<Eigen::SimplicialLDLT<Eigen::SparseMatrix<float>>> factorization;
+	std::vector<int> pattern; // of the system when it was last analyzed
+};
+
+// iterations run until the largest change of any impulse fell below the tolerance, or all of them, and that change
+struct global_result
+{
+	std::uint32_t iterations;
+	float residual;
+};
+
+// ids are the dynamic bodies of the island, columns is by object id and scratch space for their columns
+// contacts have to be prepared and hold the starting impulses, they are not applied to the bodies yet, neither are those of the joints
+// the rows are rigid, contacts aim for their target velocities, distance constraints for bias_rate per unit of error
+// and joints for the bias of their softness, the final impulses are written back to the contacts and joints
+// each iteration solves the equalities and then sweeps the bounded rows, without bounded rows one is exact
+global_result solve_global(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const std::uint32_t> ids,
+	std::span<std::uint32_t> columns, std::span<contact_constraint> contacts, std::span<const position_constraint> position_constraints,
+	std::span<const rope_constraint> rope_constraints, island_joints joints, float bias_rate, float dt, int iterations, float tolerance,
+	global_scratch &scratch);
+
+PHYSICS_END
+
+#endif
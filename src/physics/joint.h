@@ -0,0 +1,144 @@
+#ifndef JOINT_H
+#define JOINT_H
+
+#include "constraint.h"
+
+PHYSICS_BEG
+
+// joints hold points fixed to both objects together, the anchors are relative to each object's position in its unrotated frame
+// they are solved with sequential impulses along with the contacts, or as rows of its system in the global mode,
+// the impulses are kept in the joint to warm start the next step
+// errors are corrected softly at the joint_hertz and joint_damping_ratio of the solver settings
+// the xpbd mode moves the objects back onto their joints and limits in every substep, and drives the motors on the velocities
+// objects joined at overlapping shapes keep pushing each other apart, a shared negative collision_filter group stops that
+
+// pins the anchors together, the objects turn freely around them
+struct revolute_joint
+{
+	static constexpr constraint_kind kind = constraint_kind::revolute;
+
+	std::uint32_t a, b;
+	glm::vec2 local_a, local_b;
+	float reference_angle; // angle of b minus angle of a when the joint was made
+
+	// keeps the angle of b relative to a, minus the reference angle, between lower and upper
+	bool limit = false;
+	float lower_angle = 0, upper_angle = 0;
+
+	// drives the angular velocity of b relative to a towards motor_speed with at most max_motor_torque
+	bool motor = false;
+	float motor_speed = 0, max_motor_torque = 0;
+
+	std::uint32_t color = 0;
+
+	// set by the solver
+	softness soft{};
+	glm::vec2 ra{0, 0}, rb{0, 0}; // rotated anchors
+	glm::vec2 bias{0, 0}; // velocity that closes the gap between the anchors
+	float k[2][2]{}; // point mass matrix
+	float axial_mass = 0; // for the angular rows
+	float angle = 0; // relative to the reference
+	glm::vec2 impulse{0, 0};
+	float motor_impulse = 0, lower_impulse = 0, upper_impulse = 0;
+};
+
+// lets the anchor of b slide along an axis fixed to a, and keeps the relative angle at the reference
+struct prismatic_joint
+{
+	static constexpr constraint_kind kind = constraint_kind::prismatic;
+
+	std::uint32_t a, b;
+	glm::vec2 local_a, local_b;
+	glm::vec2 local_axis; // unit length, in the frame of a
+	float reference_angle;
+
+	// keeps the translation of the anchor of b along the axis between lower and upper
+	bool limit = false;
+	float lower_translation = 0, upper_translation = 0;
+
+	// drives the velocity of b along the axis towards motor_speed with at most max_motor_force
+	bool motor = false;
+	float motor_speed = 0, max_motor_force = 0;
+
+	std::uint32_t color = 0;
+
+	// set by the solver
+	softness soft{};
+	glm::vec2 axis{0, 0}, perp{0, 0};
+	float a1 = 0, a2 = 0; // moment arms of a and b about the axis
+	float s1 = 0, s2 = 0; // and about the perpendicular
+	float axial_mass = 0;
+	float k[2][2]{}; // of the perpendicular and angular rows
+	glm::vec2 bias{0, 0};
+	float translation = 0;
+	glm::vec2 impulse{0, 0}; // perpendicular and angular
+	float motor_impulse = 0, lower_impulse = 0, upper_impulse = 0;
+};
+
+// glues the objects together at the anchors and keeps the relative angle at the reference
+struct weld_joint
+{
+	static constexpr constraint_kind kind = constraint_kind::weld;
+
+	std::uint32_t a, b;
+	glm::vec2 local_a, local_b;
+	float reference_angle;
+	std::uint32_t color = 0;
+
+	// set by the solver
+	softness soft{};
+	glm::vec2 ra{0, 0}, rb{0, 0};
+	glm::vec2 bias{0, 0};
+	float angle_bias = 0;
+	float k[2][2]{};
+	float axial_mass = 0;
+	glm::vec2 impulse{0, 0};
+	float angular_impulse = 0;
+};
+
+// moves b towards an offset from a with a limited force and torque, for controlling an object without teleporting it
+struct motor_joint
+{
+	static constexpr constraint_kind kind = constraint_kind::motor;
+
+	std::uint32_t a, b;
+	glm::vec2 linear_offset; // target position of b in the frame of a
+	float angular_offset; // target angle of b relative to a
+	float max_force, max_torque;
+	float correction_factor = 5; // velocity per unit of offset error, in 1/s
+	std::uint32_t color = 0;
+
+	// set by the solver
+	glm::vec2 linear_error{0, 0};
+	float angular_error = 0;
+	float linear_mass = 0, axial_mass = 0;
+	glm::vec2 impulse{0, 0};
+	float angular_impulse = 0;
+};
+
+// computes the anchors, masses and errors of the step, positions and angles are by object id like bodies
+// without warm starting the impulses of the last step are dropped
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<revolute_joint> joints, float dt, const solver_settings &settings);
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<prismatic_joint> joints, float dt, const solver_settings &settings);
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<weld_joint> joints, float dt, const solver_settings &settings);
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<motor_joint> joints, float dt, const solver_settings &settings);
+
+// applies the impulses carried over from the last step
+void warm_start_joints(std::span<solver_body> bodies, std::span<const revolute_joint> joints);
+void warm_start_joints(std::span<solver_body> bodies, std::span<const prismatic_joint> joints);
+void warm_start_joints(std::span<solver_body> bodies, std::span<const weld_joint> joints);
+void warm_start_joints(std::span<solver_body> bodies, std::span<const motor_joint> joints);
+
+// one sequential impulse iteration over the joints in order, returns the largest change of any of their impulses
+float solve_joints(std::span<solver_body> bodies, std::span<revolute_joint> joints, float dt);
+float solve_joints(std::span<solver_body> bodies, std::span<prismatic_joint> joints, float dt);
+float solve_joints(std::span<solver_body> bodies, std::span<weld_joint> joints, float dt);
+float solve_joints(std::span<solver_body> bodies, std::span<motor_joint> joints, float dt);
+
+PHYSICS_END
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef PARTICLE_H
 #define PARTICLE_H
 
+#include <cstdint>
+
 #include "bound.h"
 
 PHYSICS_BEG
@@ -19,14 +21,41 @@ public:
 
     static constexpr float infinity = std::numeric_limits<float>::infinity();
 
-    void update(float dt)
+    // the solver corrects the velocities between the two halves of a step
+    void update_velocity(float dt)
     {
         v += a * dt;
-        pos += v * dt;
-
         w += alpha * dt;
+    }
+
+    void update_position(float dt)
+    {
+        pos += v * dt;
         angle += w * dt;
     }
+
+    void update(float dt)
+    {
+        update_velocity(dt);
+        update_position(dt);
+    }
+};
+
+// decides which pairs of objects are tested for collisions
+// objects sharing a nonzero group always collide if it is positive and never if it is negative,
+// otherwise each object's category has to be in the other's mask
+struct collision_filter
+{
+	std::uint32_t category = 1;
+	std::uint32_t mask = ~std::uint32_t{};
+	std::int32_t group = 0;
+
+	bool collides(const collision_filter &other) const
+	{
+		if (group != 0 && group == other.group)
+			return group > 0;
+		return (category & other.mask) && (other.category & mask);
+	}
 };
 
 struct object
@@ -34,6 +63,20 @@ struct object
 	particle pt;
 	glm::vec2 scale;
 	const abstract_shape *shape;
+	collision_filter filter;
+	// mixed as sqrt(a * b) for friction and max(a, b) for restitution
+	float friction = .4f;
+	float restitution = .85f;
+	// sensors only report overlaps, they are never pushed and don't change velocities
+	bool sensor = false;
+
+	// set by world
+	std::uint32_t id = 0;
+	std::uint32_t proxy = 0;
+	// sleeping objects are neither moved nor solved until something wakes their island, see world::wake
+	bool awake = true;
+	float sleep_time = 0; // how long it has been slow enough to sleep
+	std::uint32_t sleep_group = ~std::uint32_t{0}; // the island it fell asleep with
 };
 
 PHYSICS_END
@@ -0,0 +1,210 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "object.h"
+
+PHYSICS_BEG
+
+enum class solver_mode
+{
+	// sequential impulses on the velocities every time_step, overlaps are pushed apart separately
+	impulses,
+	// extended position based dynamics, steps of xpbd_step split into substeps
+	xpbd,
+	// like impulses, but the contacts, constraints and joints of an island are assembled into one sparse system first
+	// the joints and distance constraints are solved exactly and rigidly, see joint_benchmark, the contacts by gauss seidel sweeps
+	// that match the sequential impulses, at a higher cost per iteration
+	global
+};
+
+struct solver_settings
+{
+	solver_mode mode = solver_mode::impulses;
+	// seconds per step of the impulses and global modes
+	float time_step = .001f;
+	// xpbd stays stable at frame sized steps, so the step can be much longer than time_step
+	float xpbd_step = 1.f / 60;
+	int substeps = 10;
+	// most steps a single world::update takes, the time beyond them is dropped so a slow frame doesn't make the next one slower
+	// 0 for no limit
+	int max_steps = 0;
+
+	// contacts and joints correct their errors like damped springs of this frequency in hertz, a damping ratio of 1 is critical
+	// unlike a fixed fraction of the error per step, they behave the same at any step length
+	// contacts only push softly with position_iterations at 0, otherwise their overlaps are left to the position passes
+	// and the contact values do nothing
+	float contact_hertz = 30;
+	// heavily overdamped so a deep overlap is pushed out without overshooting into a bounce
+	float contact_damping_ratio = 10;
+	float joint_hertz = 60;
+	float joint_damping_ratio = 2;
+	// fastest overlapping contacts are pushed apart, only used without position iterations
+	float contact_push_velocity = 3;
+
+	int velocity_iterations = 8;
+	// an island stops iterating early once no impulse changed by more than this during an iteration, 0 always runs them all
+	float residual_tolerance = 1e-5f;
+	// non linear gauss seidel passes pushing overlapping contacts apart after the velocities are solved
+	// 0 pushes them apart softly during the velocity iterations instead, see contact_hertz
+	int position_iterations = 3;
+	// passes of the global mode, each solves the joints and distance constraints and sweeps over the contacts, limits and motors
+	int global_iterations = 30;
+	// slower approaches don't bounce, so resting contacts stay at rest
+	float restitution_threshold = 1;
+	// start from the impulses of the last step
+	bool warm_starting = true;
+	// solve both normal impulses of two point manifolds together
+	bool block_solver = true;
+	// threads solving each color of constraints, counting the calling thread
+	unsigned threads = 1;
+	// solve the distance constraints of a color several at a time with simd instructions
+	// only position and rope constraints, contacts and joints are always solved one at a time
+	bool simd = true;
+	// islands whose distance constraints form no loops have them solved exactly in one pass instead
+	bool direct_trees = true;
+	// solves the contacts once more from the ground up with the lower body of each held still, for tall stacks
+	bool shock_propagation = false;
+	// islands whose objects all stay below both speeds for time_to_sleep seconds fall asleep
+	bool sleeping = true;
+	float sleep_linear_velocity = .05f;
+	float sleep_angular_velocity = .05f;
+	float time_to_sleep = .5f;
+};
+
+// velocities of an object gathered for the solver
+struct solver_body
+{
+	glm::vec2 v;
+	float w;
+	float inv_m, inv_I;
+};
+
+// softening of a velocity constraint that corrects its error like a damped spring, for one step length
+// the impulse is mass_scale times the rigid one towards bias_rate times the error, minus impulse_scale times the accumulated impulse
+// https://box2d.org/posts/2024/02/solver2d/
+struct softness
+{
+	float bias_rate; // velocity per unit of error
+	float mass_scale;
+	float impulse_scale;
+};
+
+// a hertz of 0 is rigid without correcting the error
+softness make_softness(float hertz, float damping_ratio, float dt);
+
+struct contact_point
+{
+	glm::vec2 ra, rb; // from each body's position to the contact
+	glm::vec2 local_a, local_b; // the point on the surface of each body, in its unrotated frame
+	float normal_mass, tangent_mass;
+	float normal_impulse, tangent_impulse; // accumulated over the iterations
+	float separation; // along the normal when the contact was found, negative when overlapping
+	float bias; // target normal velocity from restitution
+	float push; // target normal velocity pushing the overlap apart, 0 if bouncing is faster
+	float mass_scale, impulse_scale; // softness of the normal impulse, 1 and 0 unless pushing
+};
+
+struct contact_constraint
+{
+	std::uint32_t a, b; // solver body indices
+	glm::vec2 normal; // points from a to b
+	float friction, restitution;
+	std::uint32_t point_count;
+	contact_point points[2];
+
+	// two point manifolds solved as a block, unused if the points are too close to coupled
+	bool block;
+	float k[2][2]; // normal mass matrix, softened on the diagonal
+	float normal_mass[2][2]; // its inverse
+};
+
+// greedy graph coloring of constraints, no two constraints of a color share a dynamic body
+// static bodies are never written to, so any number of constraints in a color can share them
+class graph_coloring
+{
+public:
+	// constraints that find no free color get overflow_color, which has to be solved serially
+	static constexpr std::uint32_t max_colors = 64;
+	static constexpr std::uint32_t overflow_color = max_colors;
+
+	void reset(std::size_t body_count) { m_used.assign(body_count, 0); }
+
+	// gives the constraint between bodies a and b the lowest color neither uses yet
+	std::uint32_t add(std::uint32_t a, std::uint32_t b, bool a_static, bool b_static);
+
+private:
+	std::vector<std::uint64_t> m_used; // bit set of the colors each body is in
+};
+
+// disjoint sets of bodies, merged along contacts and constraints to find islands
+class union_find
+{
+public:
+	void reset(std::size_t count);
+
+	std::uint32_t find(std::uint32_t x);
+	// the lower root becomes the root of the merged set, so roots don't depend on the order of calls
+	void unite(std::uint32_t a, std::uint32_t b);
+
+private:
+	std::vector<std::uint32_t> m_parent;
+};
+
+// overlap the position solvers leave alone, so resting contacts keep touching
+constexpr float contact_slop = .005f;
+
+// computes the effective masses, target velocities and softness, ra, rb, separation and normal have to be set
+void prepare_contacts(std::span<const solver_body> bodies, std::span<contact_constraint> contacts, float dt, const solver_settings &settings);
+
+// applies the impulses carried over from the last step
+void warm_start_contacts(std::span<solver_body> bodies, std::span<const contact_constraint> contacts);
+
+// one sequential impulse iteration over every contact
+// impulses are accumulated and clamped, normal impulses push apart and friction stays inside its cone
+// returns the largest change of any impulse, the residual the iterations stop on
+float solve_contacts(std::span<solver_body> bodies, std::span<contact_constraint> contacts);
+
+// drops the pushes and makes the contacts rigid, then solves them once more
+// run after the bodies moved, so the pushes move them apart without leaving them the speed
+void relax_contacts(std::span<solver_body> bodies, std::span<contact_constraint> contacts, const solver_settings &settings);
+
+// one pass moving the bodies of each contact apart along its normal, the depth is measured again from the current poses
+// positions and angles are by object id, bodies only give the masses
+// https://box2d.org/files/ErinCatto_ModelingAndSolvingConstraints_GDC2009.pdf
+void solve_contact_positions(std::span<glm::vec2> positions, std::span<float> angles, std::span<const solver_body> bodies,
+	std::span<const contact_constraint> contacts);
+
+// shock propagation, after the iterations the contacts are solved once more from the ground up
+// the lower body of each contact is held still for it, so the support of the ground reaches the top of a stack in a single pass
+// http://physbam.stanford.edu/~fedkiw/papers/stanford2003-01.pdf
+
+constexpr std::uint32_t no_level = ~std::uint32_t{0};
+
+// buffers of order_by_level, kept by the caller so they aren't allocated on every step
+struct level_scratch
+{
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> touching; // dynamic bodies and their contacts
+	std::vector<std::uint32_t> queue;
+	std::vector<std::uint32_t> order; // the result
+};
+
+// levels count the contacts between each dynamic body and the nearest static one, they are by body index
+// order gets the contacts from the lowest level up, leaving out those with no path to a static body
+void order_by_level(std::span<const solver_body> bodies, std::span<const contact_constraint> contacts, std::span<std::uint32_t> levels,
+	level_scratch &scratch);
+
+// one velocity iteration over the ordered contacts, the accumulated impulses are kept from before it for warm starting
+void propagate_shock(std::span<solver_body> bodies, std::span<const contact_constraint> contacts, std::span<const std::uint32_t> levels,
+	std::span<const std::uint32_t> order, const solver_settings &settings);
+
+// one position pass over the ordered contacts
+void propagate_shock_positions(std::span<glm::vec2> positions, std::span<float> angles, std::span<solver_body> bodies,
+	std::span<const contact_constraint> contacts, std::span<const std::uint32_t> levels, std::span<const std::uint32_t> order);
+
+PHYSICS_END
+
+#endif
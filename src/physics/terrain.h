@@ -0,0 +1,95 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "aabb_tree.h"
+
+PHYSICS_BEG
+
+// line segments through points, closed back to the first point if loop
+// the segments are kept in an aabb_tree, so a body only touches the segments under its bounds
+// meant for static ground and walls, the segments are solid on their right side, thickness deep
+// so a counter clockwise loop keeps bodies inside it
+class chain_shape : public abstract_composite
+{
+public:
+	template <std::ranges::range R>
+	chain_shape(R &&pts, bool loop, float thickness = 1) : m_loop{loop}, m_thickness{thickness}
+	{
+		for (auto pt : pts)
+			m_pts.push_back(pt);
+		build();
+	}
+
+	template <typename T>
+	chain_shape(std::initializer_list<glm::vec<2, T>> pts, bool loop, float thickness = 1) : m_loop{loop}, m_thickness{thickness}
+	{
+		for (auto pt : pts)
+			m_pts.push_back(pt);
+		build();
+	}
+
+	length_type size() const override { return static_cast<length_type>(m_pts.size()); }
+
+	glm::vec2 point(length_type i) const { return m_pts[i]; }
+	const std::vector<glm::vec2> &points() const { return m_pts; }
+	bool loop() const { return m_loop; }
+	length_type segments() const { return static_cast<length_type>(m_loop ? m_pts.size() : m_pts.size() - 1); }
+
+	bounding_box bounds() const override { return m_tree.bounds(); }
+	bool one_sided() const override { return true; }
+	float thickness() const override { return m_thickness; }
+	void query(const bounding_box &box, std::vector<shape_view> &pieces) const override;
+	shape_view piece(length_type i) const override;
+
+private:
+	std::vector<glm::vec2> m_pts;
+	aabb_tree m_tree;
+	bool m_loop;
+	float m_thickness;
+
+	void build();
+
+protected:
+	glm::vec2 support(glm::vec2 dir) const override;
+};
+
+// terrain of segments between heights sampled every spacing along x, starting at x = 0
+// the columns under a body are found directly from its bounds, the terrain is solid down to thickness below the heights
+class heightfield_shape : public abstract_composite
+{
+public:
+	template <std::ranges::range R>
+	heightfield_shape(R &&heights, float spacing, float thickness = 1) : m_spacing{spacing}, m_thickness{thickness}
+	{
+		for (float h : heights)
+			m_heights.push_back(h);
+		build();
+	}
+
+	length_type size() const override { return static_cast<length_type>(m_heights.size()); }
+
+	float height(length_type i) const { return m_heights[i]; }
+	const std::vector<float> &heights() const { return m_heights; }
+	float spacing() const { return m_spacing; }
+
+	bounding_box bounds() const override { return m_bounds; }
+	bool one_sided() const override { return true; }
+	float thickness() const override { return m_thickness; }
+	void query(const bounding_box &box, std::vector<shape_view> &pieces) const override;
+	shape_view piece(length_type i) const override;
+
+private:
+	std::vector<float> m_heights;
+	float m_spacing;
+	float m_thickness;
+	bounding_box m_bounds;
+
+	void build();
+
+protected:
+	glm::vec2 support(glm::vec2 dir) const override;
+};
+
+PHYSICS_END
+
+#endif
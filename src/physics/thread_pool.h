@@ -0,0 +1,77 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bound.h"
+
+PHYSICS_BEG
+
+// fixed set of worker threads that split loops with the calling thread
+// workers spin for a short while after each job, so back to back jobs during a step don't pay for waking them
+class thread_pool
+{
+public:
+	// threads counts the calling thread, so 1 runs everything on the caller
+	explicit thread_pool(unsigned threads);
+	~thread_pool();
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	unsigned size() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+
+	// index below size() of the thread running a chunk, 0 on the calling thread and any thread that isn't a worker of this pool
+	// lets each thread pick its own scratch buffers
+	unsigned thread_index() const { return m_owner == this ? m_index : 0; }
+
+	// calls f(begin, end) for chunks of at most grain items covering [0, count), returns once all are done
+	// chunks can run in any order and on any thread
+	template <typename F>
+	void parallel_for(std::size_t count, std::size_t grain, F &&f)
+	{
+		if (m_workers.empty() || count <= grain)
+		{
+			if (count)
+				f(std::size_t{0}, count);
+			return;
+		}
+
+		run(count, grain, [](void *ctx, std::size_t begin, std::size_t end) { (*static_cast<F *>(ctx))(begin, end); }, &f);
+	}
+
+private:
+	using job_fn = void (*)(void *ctx, std::size_t begin, std::size_t end);
+
+	std::vector<std::thread> m_workers;
+	static inline thread_local const thread_pool *m_owner = nullptr;
+	static inline thread_local unsigned m_index = 0;
+
+	// the current job, only written while no worker is inside work()
+	job_fn m_fn = nullptr;
+	void *m_ctx = nullptr;
+	std::size_t m_count = 0;
+	std::size_t m_grain = 1;
+	std::size_t m_chunks = 0;
+
+	std::atomic<std::size_t> m_next{0};
+	std::atomic<unsigned> m_done{0};
+	std::atomic<std::uint64_t> m_generation{0};
+	std::atomic<bool> m_stop{false};
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+
+	void run(std::size_t count, std::size_t grain, job_fn fn, void *ctx);
+	void work();
+	void worker(unsigned index);
+};
+
+PHYSICS_END
+
+#endif
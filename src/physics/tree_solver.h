@@ -0,0 +1,65 @@
+#ifndef TREE_SOLVER_H
+#define TREE_SOLVER_H
+
+#include "constraint.h"
+
+PHYSICS_BEG
+
+// solves the distance constraints of an island exactly when they connect its bodies as a forest, in time linear in their number
+// each body gathers the mobility of the subtree hanging from it, like the articulated body algorithm for point masses,
+// then the impulses are found from the roots down, so a chain is held at its length however long it is
+// https://www.cs.cmu.edu/~baraff/papers/sig96.pdf
+
+// buffers of solve_constraint_tree, kept by the caller so islands don't allocate them on every step
+struct tree_scratch
+{
+	// symmetric 2x2 matrix
+	struct sym2
+	{
+		float xx = 0, xy = 0, yy = 0;
+
+		sym2 &operator+=(const sym2 &o) { xx += o.xx; xy += o.xy; yy += o.yy; return *this; }
+		sym2 &operator-=(const sym2 &o) { xx -= o.xx; xy -= o.xy; yy -= o.yy; return *this; }
+		glm::vec2 operator*(glm::vec2 v) const { return {xx * v.x + xy * v.y, xy * v.x + yy * v.y}; }
+
+		float det() const { return xx * yy - xy * xy; }
+		sym2 inverse() const { float d = 1 / det(); return {yy * d, -xy * d, xx * d}; }
+	};
+
+	struct link
+	{
+		std::uint32_t a, b; // object ids
+		float dist;
+	};
+
+	static constexpr std::uint32_t none = ~std::uint32_t{0};
+
+	struct node
+	{
+		std::uint32_t parent_link = none; // to the parent body, none for roots
+		std::uint32_t anchors[2] = {none, none}; // links to static bodies
+		std::uint32_t anchor_count = 0;
+		sym2 mobility; // velocity change per impulse on the body, with its subtree following
+		glm::vec2 free_change{0, 0}; // velocity change with no impulse on the body
+		glm::vec2 change{0, 0};
+	};
+
+	std::vector<link> links;
+	std::vector<node> nodes; // by place in the island
+	union_find sets;
+	std::vector<std::uint32_t> degree; // offsets into adjacent
+	std::vector<std::uint32_t> adjacent, fill; // links by body
+	std::vector<std::uint32_t> order, parent, stack;
+	std::vector<bool> seen;
+};
+
+// ids are the dynamic bodies of the island, slots is by object id and scratch space for their place in the island
+// stretched ropes are held at their length like position constraints, bias_rate is the velocity per unit of distance error
+// returns false without changing the bodies if the constraints close a loop, then they have to be relaxed iteratively
+bool solve_constraint_tree(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const std::uint32_t> ids,
+	std::span<std::uint32_t> slots, std::span<const position_constraint> position_constraints,
+	std::span<const rope_constraint> rope_constraints, float bias_rate, tree_scratch &scratch);
+
+PHYSICS_END
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef WIDE_H
+#define WIDE_H
+
+#include "bound.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+PHYSICS_BEG
+
+// a float per lane, used to solve several independent constraints at once
+// 8 lanes with avx2, 4 with sse2 and 1 elsewhere, masks are wide_floats with all bits of a lane set or cleared
+#if defined(__AVX2__)
+
+struct wide_float
+{
+	static constexpr std::size_t width = 8;
+	__m256 v;
+
+	wide_float() = default;
+	wide_float(__m256 x) : v{x} {}
+	wide_float(float x) : v{_mm256_set1_ps(x)} {}
+
+	// lane i gets f(i), built in registers so there are no narrow stores followed by a wide load
+	template <typename F>
+	static wide_float gather(F &&f) { return _mm256_setr_ps(f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7)); }
+	void store(float *p) const { _mm256_store_ps(p, v); }
+};
+
+inline wide_float operator+(wide_float a, wide_float b) { return _mm256_add_ps(a.v, b.v); }
+inline wide_float operator-(wide_float a, wide_float b) { return _mm256_sub_ps(a.v, b.v); }
+inline wide_float operator*(wide_float a, wide_float b) { return _mm256_mul_ps(a.v, b.v); }
+inline wide_float operator/(wide_float a, wide_float b) { return _mm256_div_ps(a.v, b.v); }
+inline wide_float operator&(wide_float a, wide_float b) { return _mm256_and_ps(a.v, b.v); }
+inline wide_float operator<(wide_float a, wide_float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline wide_float operator>(wide_float a, wide_float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline wide_float operator!=(wide_float a, wide_float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+inline wide_float sqrt(wide_float a) { return _mm256_sqrt_ps(a.v); }
+// a where mask is set, b elsewhere
+inline wide_float select(wide_float mask, wide_float a, wide_float b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+struct wide_float
+{
+	static constexpr std::size_t width = 4;
+	__m128 v;
+
+	wide_float() = default;
+	wide_float(__m128 x) : v{x} {}
+	wide_float(float x) : v{_mm_set1_ps(x)} {}
+
+	// lane i gets f(i), built in registers so there are no narrow stores followed by a wide load
+	template <typename F>
+	static wide_float gather(F &&f) { return _mm_setr_ps(f(0), f(1), f(2), f(3)); }
+	void store(float *p) const { _mm_store_ps(p, v); }
+};
+
+inline wide_float operator+(wide_float a, wide_float b) { return _mm_add_ps(a.v, b.v); }
+inline wide_float operator-(wide_float a, wide_float b) { return _mm_sub_ps(a.v, b.v); }
+inline wide_float operator*(wide_float a, wide_float b) { return _mm_mul_ps(a.v, b.v); }
+inline wide_float operator/(wide_float a, wide_float b) { return _mm_div_ps(a.v, b.v); }
+inline wide_float operator&(wide_float a, wide_float b) { return _mm_and_ps(a.v, b.v); }
+inline wide_float operator<(wide_float a, wide_float b) { return _mm_cmplt_ps(a.v, b.v); }
+inline wide_float operator>(wide_float a, wide_float b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline wide_float operator!=(wide_float a, wide_float b) { return _mm_cmpneq_ps(a.v, b.v); }
+inline wide_float sqrt(wide_float a) { return _mm_sqrt_ps(a.v); }
+// a where mask is set, b elsewhere
+inline wide_float select(wide_float mask, wide_float a, wide_float b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+
+#else
+
+struct wide_float
+{
+	static constexpr std::size_t width = 1;
+	float v;
+
+	wide_float() = default;
+	wide_float(float x) : v{x} {}
+
+	template <typename F>
+	static wide_float gather(F &&f) { return f(0); }
+	void store(float *p) const { *p = v; }
+};
+
+inline wide_float operator+(wide_float a, wide_float b) { return a.v + b.v; }
+inline wide_float operator-(wide_float a, wide_float b) { return a.v - b.v; }
+inline wide_float operator*(wide_float a, wide_float b) { return a.v * b.v; }
+inline wide_float operator/(wide_float a, wide_float b) { return a.v / b.v; }
+// masks are 1 or 0
+inline wide_float operator&(wide_float a, wide_float b) { return a.v * b.v; }
+inline wide_float operator<(wide_float a, wide_float b) { return a.v < b.v ? 1.f : 0.f; }
+inline wide_float operator>(wide_float a, wide_float b) { return a.v > b.v ? 1.f : 0.f; }
+inline wide_float operator!=(wide_float a, wide_float b) { return a.v != b.v ? 1.f : 0.f; }
+inline wide_float sqrt(wide_float a) { return std::sqrt(a.v); }
+inline wide_float select(wide_float mask, wide_float a, wide_float b) { return mask.v != 0 ? a : b; }
+
+#endif
+
+PHYSICS_END
+
+#endif
@@ -1,14 +1,23 @@
 #ifndef WORLD_H
 #define WORLD_H
+#include <algorithm>
+#include <array>
 #include <list>
 #include <memory>
+#include <type_traits>
 
 #include "constraint.h"
+#include "joint.h"
+#include "terrain.h"
+#include "aabb_tree.h"
+#include "solver.h"
+#include "thread_pool.h"
+#include "xpbd.h"
+#include "global_solver.h"
+#include "tree_solver.h"
 
 PHYSICS_BEG
 
-void resolve_velocities(particle &p1, glm::vec2 p1_center, particle &p2, glm::vec2 p2_center, const collision &coll, float e);
-
 class world
 {
 public:
@@ -16,43 +25,319 @@ public:
 	world(float world_width_meters, float world_height_meters, float gravity = -10);
 
 	// make sure poly is not destroyed before world
-	object *add_object(const abstract_shape &shape, glm::vec2 pos, glm::vec2 v_init, float angle, float w_init, float mass, glm::vec2 scale);
+	object *add_object(const abstract_shape &shape, glm::vec2 pos, glm::vec2 v_init, float angle, float w_init, float mass, glm::vec2 scale,
+		collision_filter filter = {});
 
 	// make sure poly is not destroyed before world
 	// add object of infinite mass that stays in place
-	object *add_static_object(const abstract_shape &shape, glm::vec2 pos, float angle, glm::vec2 scale);
+	object *add_static_object(const abstract_shape &shape, glm::vec2 pos, float angle, glm::vec2 scale, collision_filter filter = {});
 
-	void add_constraint(std::unique_ptr<constraint> c) { constraints.push_back(std::move(c)); }
+	// constraints are stored by type, the handle removes them again
+	// adding or removing wakes both objects, compliance only softens them in xpbd mode
+	constraint_handle add_position_constraint(object &a, object &b, float distance, float compliance = 0);
+	constraint_handle add_rope_constraint(object &a, object &b, float distance, float compliance = 0);
+	// joints take their anchor, and the axis of a prismatic joint, in world space, the current angles become the reference
+	constraint_handle add_revolute_joint(object &a, object &b, glm::vec2 anchor);
+	constraint_handle add_prismatic_joint(object &a, object &b, glm::vec2 anchor, glm::vec2 axis);
+	constraint_handle add_weld_joint(object &a, object &b, glm::vec2 anchor);
+	// starts out holding b at its current offset from a
+	constraint_handle add_motor_joint(object &a, object &b, float max_force, float max_torque);
+	// returns false if the constraint was already removed
+	bool remove_constraint(constraint_handle h);
 
-	void update(float dt)
+	// the constraint of the handle, to change its limits, motor or offsets, nullptr if it was removed or is of another type
+	// wake its objects after changing it
+	template <typename T>
+	T *find_constraint(constraint_handle h)
 	{
-		if (dt > time_step)
-			for (; dt > 0; dt -= time_step)
-				update_internal();
+		T *found = nullptr;
+		for_each_bucket([&](auto &bucket)
+		{
+			if constexpr (std::is_same_v<typename std::remove_reference_t<decltype(bucket)>::value_type, T>)
+				if (bucket.contains(h))
+					found = &bucket[h];
+		});
+		return found;
 	}
 
+	// wakes the object and everything that fell asleep with it, call it after changing a sleeping object
+	void wake(object &obj);
+
+	// moves the object at once and wakes it, both transform buffers take the new pose so it is drawn there instead of sliding
+	// poses written to obj.pt directly only show after the next step
+	void set_transform(object &obj, glm::vec2 pos, float angle);
+
+	// counters summed over the steps of the last update
+	struct step_stats
+	{
+		std::size_t steps;
+		std::size_t broadphase_pairs; // pairs whose bounds overlap
+		std::size_t filtered_pairs; // broadphase pairs skipped by their collision filters
+		std::size_t narrowphase_tests;
+		std::size_t sensor_tests;
+		std::size_t collisions;
+		std::size_t velocity_iterations; // run by all islands
+		std::size_t skipped_iterations; // left out because the island had converged
+		float residual; // largest final residual of any island, the impulse change of its last iteration
+	};
+
+	struct sensor_event
+	{
+		object *sensor;
+		object *visitor;
+		bool begin; // false when the overlap ended
+	};
+
+	struct contact_event
+	{
+		enum class kind { begin, persist, end };
+
+		kind type;
+		std::uint32_t step; // index of the step within the last update
+		object *a, *b; // a has the lower id
+		glm::vec2 normal; // points from a to b
+		glm::vec2 points[2]; // world space
+		std::uint32_t point_count; // 0 for end events
+		float impulse; // normal impulse applied during the step
+	};
+
+	// runs as many whole steps as fit into dt, the rest is carried over to the next update
+	void update(float dt);
+
+	// seconds simulated by each step, depends on the solver mode
+	float step_length() const { return solver.mode == solver_mode::xpbd ? solver.xpbd_step : solver.time_step; }
+
+	// how far the time of the updates is past the last step, in steps from 0 to 1
+	// drawing the objects this far between their previous and current transforms hides the steps not lining up with the frames
+	float interpolation_alpha() const { return std::min(accumulator / step_length(), 1.f); }
+
+	// positions and angles by object id, kept apart so interpolating them runs over contiguous arrays
+	struct transforms
+	{
+		std::span<const glm::vec2> positions;
+		std::span<const float> angles;
+	};
+
+	// the objects before and after the last step, objects added or moved by set_transform since are in both as they are now
+	transforms previous_transforms() const { return {prev_positions, prev_angles}; }
+	transforms current_transforms() const { return {cur_positions, cur_angles}; }
+
 	float width() const { return world_width; }
 	float height() const { return world_height; }
 	float gravity() const { return grav; }
 
+	const step_stats &stats() const { return counters; }
+
+	// groups of dynamic objects connected by contacts or constraints, each is solved on its own
+	struct island_stats
+	{
+		std::size_t count;
+		std::size_t largest; // in objects
+		std::size_t split; // islands big enough to be spread over several threads
+		std::size_t sleeping; // objects asleep after the step
+		std::array<std::size_t, 16> sizes; // sizes[i] counts the islands of 2^i up to 2^(i+1) - 1 objects, the last also takes bigger ones
+		std::size_t iterations; // velocity iterations run by all islands
+		std::size_t most_iterations; // by a single island
+		float residual; // largest final residual
+	};
+
+	// islands of the last step
+	const island_stats &last_islands() const { return island_counters; }
+
+	// how the solve of one island of the last step ended
+	struct island_solve
+	{
+		std::size_t objects;
+		std::uint32_t iterations; // velocity iterations until the residual fell below the tolerance, or all of them
+		float residual; // largest impulse change of the last iteration
+	};
+
+	// one entry per island of the last step, empty in the xpbd mode
+	const std::vector<island_solve> &island_solves() const { return solves; }
+
+	solver_settings &settings() { return solver; }
+	const solver_settings &settings() const { return solver; }
+
+	// sensor overlaps that began or ended during the last update, in step order
+	const std::vector<sensor_event> &sensor_events() const { return events; }
+
+	// contacts that began, persisted or ended during the last update, in step order
+	// events are only collected after the step is solved, so there are no callbacks while solving
+	const std::vector<contact_event> &contact_events() const { return contacts; }
+	// takes the events without copying, the old contents of buffer are dropped and its memory reused by the world
+	void swap_contact_events(std::vector<contact_event> &buffer) { buffer.clear(); contacts.swap(buffer); }
+
 private:
 	struct collision_pair
 	{
 		std::list<object>::iterator a, b;
 		collision coll;
+		float impulse = 0;
+		std::uint32_t island = 0, color = 0;
+	};
+
+	// constraints of a color share no dynamic body and are solved in parallel, unless serial is set
+	struct color_range
+	{
+		std::uint32_t begin, end;
+		bool serial;
+	};
+
+	struct index_range
+	{
+		std::uint32_t begin = 0, end = 0;
 	};
 
+	struct island
+	{
+		index_range bodies; // in island_bodies
+		index_range contacts; // in collisions
+		index_range contact_colors; // in contact_colors
+		std::array<index_range, constraint_kinds> constraints; // in the bucket of each kind
+		std::array<index_range, constraint_kinds> constraint_colors; // in constraint_colors of each kind
+		bool split; // colors are spread over the pool
+		bool sleepy; // every object was slow for long enough
+		std::uint32_t iterations; // velocity iterations run
+		float residual;
+	};
+
+	using object_pair = std::pair<std::list<object>::iterator, std::list<object>::iterator>;
+
+	std::unique_ptr<chain_shape> boundary;
 	std::list<object> objects;
 	std::vector<collision_pair> collisions;
-	std::vector<std::unique_ptr<constraint>> constraints;
+
+	// objects by id, ids are never reused
+	std::vector<std::list<object>::iterator> by_id;
+	aabb_tree broadphase{aabb_margin};
+	std::vector<std::uint32_t> order; // position of each object id in objects
+	std::vector<object_pair> pairs;
+	std::vector<object_pair> sensor_pairs; // the sensor is first
+	std::vector<std::uint64_t> overlaps, prev_overlaps; // sorted sensor and visitor ids
+	std::vector<sensor_event> events;
+	std::vector<piece_pair> pieces; // scratch of the narrowphase
+	std::vector<collision> manifolds; // scratch of the narrowphase
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> touching; // sorted pair ids and their deepest collision
+	std::vector<std::uint64_t> prev_touching;
+	std::vector<std::uint64_t> resting; // sleeping pairs carried over from prev_touching
+	std::vector<contact_event> contacts;
+
+	struct cached_impulse
+	{
+		std::uint64_t key, pieces;
+		float normal[2], tangent[2];
+	};
+
+	solver_settings solver;
+	std::vector<solver_body> bodies; // by object id
+	std::vector<glm::vec2> positions; // by object id, gathered with bodies
+	std::vector<float> angles; // by object id, gathered with bodies
+	std::vector<glm::vec2> prev_positions, cur_positions; // by object id, around the last step of an update
+	std::vector<float> prev_angles, cur_angles;
+	std::vector<contact_constraint> contact_constraints; // same order as collisions
+	std::vector<cached_impulse> impulse_cache; // sorted by key and pieces
+	std::vector<xpbd_body> xpbd_bodies; // by object id
+	std::vector<xpbd_contact> xpbd_contacts; // same order as collisions
+	std::vector<std::uint32_t> island_slots; // by object id, scratch for the island solvers
+
+	// buffers of the island solvers that can't be shared, one set per thread of the pool
+	struct island_scratch
+	{
+		tree_scratch tree;
+		level_scratch levels;
+		global_scratch global;
+	};
+	std::vector<island_scratch> scratch;
+
+	std::unique_ptr<thread_pool> pool;
+	graph_coloring coloring;
+	union_find island_sets;
+	std::vector<island> islands;
+	std::vector<std::uint32_t> island_of; // by object id, no_island for static and unconnected objects
+	std::vector<std::uint32_t> root_island; // island of each set root
+	std::vector<std::uint32_t> island_bodies; // object ids grouped by island
+	std::vector<std::uint32_t> small_islands, large_islands;
+	std::vector<std::uint32_t> loose_bodies; // awake dynamic objects in no island
+	std::vector<island_solve> solves; // same order as islands
+	std::vector<std::vector<std::uint32_t>> sleep_groups; // object ids of each sleeping island, empty when free
+	std::vector<std::uint32_t> free_sleep_groups;
+	std::size_t sleeping_count = 0;
+	std::vector<color_range> contact_colors; // ranges of collisions
+
+	// each bucket is kept sorted by island and color
+	constraint_bucket<position_constraint> position_constraints;
+	constraint_bucket<rope_constraint> rope_constraints;
+	constraint_bucket<revolute_joint> revolute_joints;
+	constraint_bucket<prismatic_joint> prismatic_joints;
+	constraint_bucket<weld_joint> weld_joints;
+	constraint_bucket<motor_joint> motor_joints;
+	std::array<std::vector<color_range>, constraint_kinds> constraint_colors; // ranges of each bucket
+	std::array<bool, constraint_kinds> constraints_colored{};
+	std::vector<std::uint64_t> constraint_keys; // island and color of each constraint being sorted
+	std::vector<std::uint32_t> constraint_order;
+
+	step_stats counters{};
+	island_stats island_counters{};
 
 	float grav;
 	float world_width, world_height;
+	float accumulator = 0; // seconds passed to update that no step has simulated yet
 
-	static constexpr float time_step = .001f;
+	static constexpr float aabb_margin = .1f;
+	// fewest constraints worth handing to another thread
+	static constexpr std::size_t parallel_grain = 64;
+	// islands with more contacts and constraints than this have their colors split over the pool instead of being one task
+	static constexpr std::size_t large_island = 4 * parallel_grain;
+	static constexpr std::uint32_t no_island = ~std::uint32_t{0};
+
+	object *insert_object(const object &obj);
+	void store_transforms(std::vector<glm::vec2> &to_positions, std::vector<float> &to_angles) const;
 
 	void update_internal();
+	void update_broadphase();
 	void resolve_bounds();
+	void update_sensors();
+	void update_contacts();
+	void update_pool();
+	template <typename T>
+	constraint_handle add_constraint(constraint_bucket<T> &bucket, const T &c);
+	// calls f on every constraint bucket, each with its own type
+	template <typename F>
+	void for_each_bucket(F &&f)
+	{
+		for_each_distance_bucket(f);
+		for_each_joint_bucket(f);
+	}
+	template <typename F>
+	void for_each_distance_bucket(F &&f)
+	{
+		f(position_constraints);
+		f(rope_constraints);
+	}
+	template <typename F>
+	void for_each_joint_bucket(F &&f)
+	{
+		f(revolute_joints);
+		f(prismatic_joints);
+		f(weld_joints);
+		f(motor_joints);
+	}
+	template <typename T>
+	void sort_constraints(constraint_bucket<T> &bucket);
+	template <typename KeyAt, typename RangesOf>
+	void group_by_island(std::size_t count, KeyAt key_at, std::vector<color_range> &ranges, RangesOf ranges_of);
+	void build_islands();
+	void solve_islands();
+	void solve_island(island &isl);
+	void solve_island_xpbd(island &isl);
+	bool update_sleep_time(object &obj) const;
+	void sleep(std::span<const std::uint32_t> ids);
+	void update_sleeping();
+	template <typename F>
+	void for_each_color(const island &isl, index_range colors, const std::vector<color_range> &ranges, F &&f);
+	template <typename F>
+	void for_each_chunk(const island &isl, index_range items, F &&f);
+	void update_impulse_cache();
 };
 
 
@@ -0,0 +1,65 @@
+#ifndef XPBD_H
+#define XPBD_H
+
+#include "constraint.h"
+#include "joint.h"
+
+PHYSICS_BEG
+
+// extended position based dynamics: constraints move the objects directly and the velocities come from how far they moved
+// each step is split into substeps with one pass over the constraints each, compliance makes stiffness independent of the step
+// https://matthias-research.github.io/pages/publications/PBDBodies.pdf
+
+// pose and velocities of an object during the substeps of a step
+struct xpbd_body
+{
+	glm::vec2 pos, prev_pos;
+	float angle, prev_angle;
+	glm::vec2 v;
+	float w;
+	glm::vec2 a; // external accelerations
+	float alpha;
+	float inv_m, inv_I;
+};
+
+// the manifold of a substep, its points are kept in the frames of both objects so the depth follows them through the corrections
+struct xpbd_contact
+{
+	std::uint32_t a, b;
+	glm::vec2 normal; // from a to b
+	float friction, restitution;
+	std::uint32_t point_count;
+	glm::vec2 local_a[2], local_b[2]; // the point on the surface of each object
+	float normal_lambda[2]; // position impulses of the current substep
+	float normal_velocity[2]; // before the current substep, for restitution
+	float impulse; // normal impulse summed over the substeps of the step
+};
+
+// bodies and ids are by object id, ids selects the bodies to move
+void xpbd_integrate(std::span<xpbd_body> bodies, std::span<const std::uint32_t> ids, float h);
+void xpbd_update_velocities(std::span<xpbd_body> bodies, std::span<const std::uint32_t> ids, float h);
+
+// one pass over the constraints in order, h is the substep
+void xpbd_solve_constraints(std::span<xpbd_body> bodies, std::span<const position_constraint> constraints, float h);
+void xpbd_solve_constraints(std::span<xpbd_body> bodies, std::span<const rope_constraint> constraints, float h);
+
+// one pass moving the objects back onto their joints and limits, h is the substep
+// motor joints only act on the velocities
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const revolute_joint> joints, float h);
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const prismatic_joint> joints, float h);
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const weld_joint> joints, float h);
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const motor_joint> joints, float h);
+// motors on the velocities of the substep, with at most their force or torque over it, welds have none
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const revolute_joint> joints, float h);
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const prismatic_joint> joints, float h);
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const weld_joint> joints, float h);
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const motor_joint> joints, float h);
+
+// pushes the contact points apart and holds them with static friction
+void xpbd_solve_contacts(std::span<xpbd_body> bodies, std::span<xpbd_contact> contacts, float h);
+// dynamic friction and restitution on the velocities of the substep
+void xpbd_solve_contact_velocities(std::span<xpbd_body> bodies, std::span<xpbd_contact> contacts, float h, float restitution_threshold);
+
+PHYSICS_END
+
+#endif
@@ -0,0 +1,239 @@
+#include "aabb_tree.h"
+
+PHYSICS_BEG
+
+aabb_tree::proxy aabb_tree::insert(const bounding_box &box, std::uint32_t data)
+{
+	proxy id = allocate();
+	m_nodes[id].box = box.fatten(m_margin);
+	m_nodes[id].data = data;
+	m_nodes[id].height = 0;
+
+	insert_leaf(id);
+	return id;
+}
+
+void aabb_tree::remove(proxy id)
+{
+	remove_leaf(id);
+	release(id);
+}
+
+bool aabb_tree::move(proxy id, const bounding_box &box)
+{
+	if (m_nodes[id].box.contains(box))
+		return false;
+
+	remove_leaf(id);
+	m_nodes[id].box = box.fatten(m_margin);
+	insert_leaf(id);
+
+	return true;
+}
+
+void aabb_tree::clear()
+{
+	m_nodes.clear();
+	m_root = null_proxy;
+	m_free = null_proxy;
+}
+
+aabb_tree::proxy aabb_tree::allocate()
+{
+	proxy id;
+	if (m_free != null_proxy)
+	{
+		id = m_free;
+		m_free = m_nodes[id].parent;
+	}
+	else
+	{
+		id = static_cast<proxy>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	m_nodes[id].parent = m_nodes[id].left = m_nodes[id].right = null_proxy;
+	m_nodes[id].data = 0;
+	m_nodes[id].height = 0;
+	return id;
+}
+
+void aabb_tree::release(proxy id)
+{
+	m_nodes[id].parent = m_free;
+	m_nodes[id].height = -1;
+	m_free = id;
+}
+
+void aabb_tree::insert_leaf(proxy leaf)
+{
+	if (m_root == null_proxy)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = null_proxy;
+		return;
+	}
+
+	// find the sibling that grows the total perimeter of the tree the least
+	bounding_box leaf_box = m_nodes[leaf].box;
+	proxy index = m_root;
+	while (!m_nodes[index].leaf())
+	{
+		const node &cur = m_nodes[index];
+
+		float combined = cur.box.merge(leaf_box).perimeter();
+
+		// cost of making a new parent for this node and the leaf
+		float cost = 2 * combined;
+		// cost of pushing the leaf further down the tree
+		float inheritance = 2 * (combined - cur.box.perimeter());
+
+		auto descend_cost = [&](proxy child)
+		{
+			const node &c = m_nodes[child];
+			float merged = c.box.merge(leaf_box).perimeter();
+			return c.leaf() ? merged + inheritance : merged - c.box.perimeter() + inheritance;
+		};
+
+		float cost_left = descend_cost(cur.left);
+		float cost_right = descend_cost(cur.right);
+
+		if (cost < cost_left && cost < cost_right)
+			break;
+
+		index = cost_left < cost_right ? cur.left : cur.right;
+	}
+
+	proxy sibling = index;
+	proxy old_parent = m_nodes[sibling].parent;
+	proxy new_parent = allocate();
+
+	m_nodes[new_parent].parent = old_parent;
+	m_nodes[new_parent].box = leaf_box.merge(m_nodes[sibling].box);
+	m_nodes[new_parent].height = m_nodes[sibling].height + 1;
+	m_nodes[new_parent].left = sibling;
+	m_nodes[new_parent].right = leaf;
+
+	if (old_parent != null_proxy)
+	{
+		if (m_nodes[old_parent].left == sibling)
+			m_nodes[old_parent].left = new_parent;
+		else
+			m_nodes[old_parent].right = new_parent;
+	}
+	else
+		m_root = new_parent;
+
+	m_nodes[sibling].parent = new_parent;
+	m_nodes[leaf].parent = new_parent;
+
+	refit(old_parent);
+}
+
+void aabb_tree::remove_leaf(proxy leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = null_proxy;
+		return;
+	}
+
+	proxy parent = m_nodes[leaf].parent;
+	proxy grand_parent = m_nodes[parent].parent;
+	proxy sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+	m_nodes[sibling].parent = grand_parent;
+	if (grand_parent != null_proxy)
+	{
+		if (m_nodes[grand_parent].left == parent)
+			m_nodes[grand_parent].left = sibling;
+		else
+			m_nodes[grand_parent].right = sibling;
+
+		release(parent);
+		refit(grand_parent);
+	}
+	else
+	{
+		m_root = sibling;
+		release(parent);
+	}
+}
+
+void aabb_tree::refit(proxy id)
+{
+	while (id != null_proxy)
+	{
+		id = balance(id);
+
+		node &n = m_nodes[id];
+		n.height = 1 + std::max(m_nodes[n.left].height, m_nodes[n.right].height);
+		n.box = m_nodes[n.left].box.merge(m_nodes[n.right].box);
+
+		id = n.parent;
+	}
+}
+
+// rotates the taller child of a up if the children's heights differ by more than one
+// returns the node that took a's place
+aabb_tree::proxy aabb_tree::balance(proxy a_id)
+{
+	node &a = m_nodes[a_id];
+	if (a.leaf() || a.height < 2)
+		return a_id;
+
+	proxy b_id = a.left;
+	proxy c_id = a.right;
+	node &b = m_nodes[b_id];
+	node &c = m_nodes[c_id];
+
+	int diff = c.height - b.height;
+	if (diff >= -1 && diff <= 1)
+		return a_id;
+
+	// the taller child replaces a, a keeps the shorter child and the shorter grandchild
+	proxy up_id = diff > 1 ? c_id : b_id;
+	node &up = m_nodes[up_id];
+	node &kept = diff > 1 ? b : c;
+
+	proxy f_id = up.left;
+	proxy g_id = up.right;
+	node &f = m_nodes[f_id];
+	node &g = m_nodes[g_id];
+
+	up.left = a_id;
+	up.parent = a.parent;
+	a.parent = up_id;
+
+	if (up.parent != null_proxy)
+	{
+		if (m_nodes[up.parent].left == a_id)
+			m_nodes[up.parent].left = up_id;
+		else
+			m_nodes[up.parent].right = up_id;
+	}
+	else
+		m_root = up_id;
+
+	proxy tall_id = f.height > g.height ? f_id : g_id;
+	proxy short_id = f.height > g.height ? g_id : f_id;
+	node &tall = m_nodes[tall_id];
+	node &shrt = m_nodes[short_id];
+
+	up.right = tall_id;
+	if (diff > 1)
+		a.right = short_id;
+	else
+		a.left = short_id;
+	shrt.parent = a_id;
+
+	a.box = kept.box.merge(shrt.box);
+	up.box = a.box.merge(tall.box);
+
+	a.height = 1 + std::max(kept.height, shrt.height);
+	up.height = 1 + std::max(a.height, tall.height);
+
+	return up_id;
+}
+
+PHYSICS_END
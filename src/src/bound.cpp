@@ -1,5 +1,7 @@
 #include "bound.h"
 
+#include <algorithm>
+
 PHYSICS_BEG
 
 inline bool contains_origin(std::vector<glm::vec2> &simplex, glm::vec2 &dir)
@@ -74,13 +76,18 @@ edge closest_edge(std::vector<glm::vec2> &simplex)
 	edge closest;
 	closest.dist = std::numeric_limits<float>::infinity();
 
+	// the normals point out of the polytope by its winding, the origin can't tell for edges through it, like those of touching shapes
+	float winding = 0;
+	for (unsigned int i = 0; i < simplex.size(); ++i)
+		winding += cross(simplex[i], simplex[(i + 1) % simplex.size()]);
+
 	for (unsigned int i = 0; i < simplex.size(); ++i)
 	{
 		const glm::vec2 &a = simplex[i];
 		const glm::vec2 &b = simplex[(i + 1) % simplex.size()];
 		glm::vec2 ab = b - a;
 		glm::vec2 norm = { ab.y, -ab.x };
-		if (glm::dot(a, norm) < 0)
+		if (winding < 0)
 			norm *= -1;
 		norm = glm::normalize(norm);
 
@@ -113,11 +120,123 @@ collision epa(std::vector<glm::vec2> &simplex, const shape_view &a, const shape_
 	}
 }
 
-// returns collision with mtv to get a out of b or false if no collision
-collision collides(const shape_view &a, const shape_view &b)
+// the vertex or edge of view furthest in dir
+// edges are found with two slightly rotated support directions, curved shapes only give a vertex
+struct feature
+{
+	glm::vec2 v1, v2;
+	bool edge;
+};
+
+feature support_feature(const shape_view &view, glm::vec2 dir)
+{
+	constexpr float angle = .02f;
+	const float c = std::cos(angle), s = std::sin(angle);
+
+	glm::vec2 p0 = view.support(dir);
+	glm::vec2 p1 = view.support({c * dir.x - s * dir.y, s * dir.x + c * dir.y});
+	glm::vec2 p2 = view.support({c * dir.x + s * dir.y, c * dir.y - s * dir.x});
+
+	glm::vec2 e = p2 - p1;
+	float len = glm::length(e);
+	if (len < 1e-6f)
+		return {p0, p0, false};
+
+	// a flat edge has the middle support point on it, a curve bulges out
+	float bulge = std::abs(e.x * (p0.y - p1.y) - e.y * (p0.x - p1.x)) / len;
+	if (bulge > 1e-3f * len)
+		return {p0, p0, false};
+
+	return {p1, p2, true};
+}
+
+// fills the contact points of res by clipping the features of a and b against each other
+// a_radius and b_radius are convex radii around the features
+void fill_manifold(collision &res, const shape_view &a, const shape_view &b, float a_radius = 0, float b_radius = 0)
+{
+	glm::vec2 n = res.normal;
+	feature fa = support_feature(a, n);
+	feature fb = support_feature(b, -n);
+
+	// resting contacts are pushed apart to about 0 depth, so points slightly apart still count
+	constexpr float slop = .005f;
+
+	auto add_point = [&](glm::vec2 a_pt, glm::vec2 b_pt)
+	{
+		float depth = glm::dot(a_pt - b_pt, n);
+		if (depth <= -slop)
+			return;
+		res.points[res.point_count] = (a_pt + b_pt) / 2.f;
+		res.depths[res.point_count] = depth;
+		++res.point_count;
+	};
+
+	res.point_count = 0;
+	if (fa.edge && fb.edge)
+	{
+		glm::vec2 ea = glm::normalize(fa.v2 - fa.v1);
+		glm::vec2 eb = glm::normalize(fb.v2 - fb.v1);
+
+		// the edge facing the normal the most is the reference, the other is clipped to its sides
+		bool a_ref = std::abs(glm::dot(ea, n)) <= std::abs(glm::dot(eb, n));
+		const feature &ref = a_ref ? fa : fb;
+		const feature &inc = a_ref ? fb : fa;
+
+		glm::vec2 t = a_ref ? ea : eb;
+		float lo = glm::dot(ref.v1, t), hi = glm::dot(ref.v2, t);
+		if (lo > hi)
+			std::swap(lo, hi);
+
+		float d1 = glm::dot(inc.v1, t), d2 = glm::dot(inc.v2, t);
+		if (std::abs(d2 - d1) > 1e-9f)
+		{
+			float t1 = std::clamp((lo - d1) / (d2 - d1), 0.f, 1.f);
+			float t2 = std::clamp((hi - d1) / (d2 - d1), 0.f, 1.f);
+
+			for (float u : {std::min(t1, t2), std::max(t1, t2)})
+			{
+				glm::vec2 p = inc.v1 + (inc.v2 - inc.v1) * u;
+				// p projected onto the reference edge's line
+				glm::vec2 on_ref = p - n * glm::dot(p - ref.v1, n);
+
+				if (a_ref)
+					add_point(on_ref + n * a_radius, p - n * b_radius);
+				else
+					add_point(p + n * a_radius, on_ref - n * b_radius);
+			}
+
+			if (res.point_count == 2 && glm::length(res.points[1] - res.points[0]) < 1e-4f)
+				res.point_count = 1;
+		}
+	}
+
+	if (res.point_count)
+		return;
+
+	// a vertex touches, the contact is at the vertex
+	if (!fa.edge || fb.edge)
+	{
+		glm::vec2 a_pt = fa.v1 + n * a_radius;
+		add_point(a_pt, a_pt - n * res.dist);
+	}
+	else
+	{
+		glm::vec2 b_pt = fb.v1 - n * b_radius;
+		add_point(b_pt + n * res.dist, b_pt);
+	}
+
+	if (!res.point_count)
+	{
+		res.points[0] = (res.a_contact + res.b_contact) / 2.f;
+		res.depths[0] = res.dist;
+		res.point_count = 1;
+	}
+}
+
+// gjk, true if the minkowski difference contains the origin, which simplex then surrounds
+bool gjk(const shape_view &a, const shape_view &b, std::vector<glm::vec2> &simplex)
 {
 	glm::vec2 dir{1, 0};
-	thread_local std::vector<glm::vec2> simplex(3);
 	simplex.clear();
 
 	simplex.push_back(a.support(dir) - b.support(-dir));
@@ -127,12 +246,618 @@ collision collides(const shape_view &a, const shape_view &b)
 	{
 		glm::vec2 new_pt = a.support(dir) - b.support(-dir);
 		if (glm::dot(new_pt, dir) <= 0)
-			return {}; // doesn't collide
+			return false;
 
 		simplex.push_back(new_pt);
 		if (contains_origin(simplex, dir))
-			return epa(simplex, a, b); // collides
+			return true;
+	}
+}
+
+// gjk for convex shapes
+collision convex_collides(const shape_view &a, const shape_view &b)
+{
+	thread_local std::vector<glm::vec2> simplex(3);
+	if (!gjk(a, b, simplex))
+		return {}; // doesn't collide
+
+	collision res = epa(simplex, a, b); // collides
+	fill_manifold(res, a, b);
+	return res;
+}
+
+struct simplex_vertex
+{
+	glm::vec2 a; // support point of shape "a"
+	glm::vec2 b; // support point of shape "b"
+	glm::vec2 w; // a - b
+	float bary; // barycentric weight of the closest point
+};
+
+// reduces the simplex to the feature closest to the origin and sets the barycentric weights
+// returns false if the origin is inside the triangle
+bool solve_simplex(simplex_vertex *v, int &count)
+{
+	if (count == 1)
+	{
+		v[0].bary = 1;
+		return true;
+	}
+
+	if (count == 2)
+	{
+		glm::vec2 e12 = v[1].w - v[0].w;
+		float d12_2 = -glm::dot(v[0].w, e12);
+		float d12_1 = glm::dot(v[1].w, e12);
+
+		if (d12_2 <= 0)
+		{
+			v[0].bary = 1;
+			count = 1;
+		}
+		else if (d12_1 <= 0)
+		{
+			v[0] = v[1];
+			v[0].bary = 1;
+			count = 1;
+		}
+		else
+		{
+			v[0].bary = d12_1 / (d12_1 + d12_2);
+			v[1].bary = d12_2 / (d12_1 + d12_2);
+		}
+		return true;
+	}
+
+	glm::vec2 w1 = v[0].w, w2 = v[1].w, w3 = v[2].w;
+
+	glm::vec2 e12 = w2 - w1;
+	float d12_1 = glm::dot(w2, e12);
+	float d12_2 = -glm::dot(w1, e12);
+
+	glm::vec2 e13 = w3 - w1;
+	float d13_1 = glm::dot(w3, e13);
+	float d13_2 = -glm::dot(w1, e13);
+
+	glm::vec2 e23 = w3 - w2;
+	float d23_1 = glm::dot(w3, e23);
+	float d23_2 = -glm::dot(w2, e23);
+
+	auto cross = [](glm::vec2 a, glm::vec2 b) { return a.x * b.y - a.y * b.x; };
+	float n123 = cross(e12, e13);
+	float d123_1 = n123 * cross(w2, w3);
+	float d123_2 = n123 * cross(w3, w1);
+	float d123_3 = n123 * cross(w1, w2);
+
+	auto keep_vertex = [&](int i)
+	{
+		v[0] = v[i];
+		v[0].bary = 1;
+		count = 1;
+		return true;
+	};
+
+	auto keep_edge = [&](int i, int j, float di, float dj)
+	{
+		simplex_vertex vi = v[i], vj = v[j];
+		v[0] = vi;
+		v[1] = vj;
+		v[0].bary = di / (di + dj);
+		v[1].bary = dj / (di + dj);
+		count = 2;
+		return true;
+	};
+
+	if (d12_2 <= 0 && d13_2 <= 0)
+		return keep_vertex(0);
+	if (d12_1 > 0 && d12_2 > 0 && d123_3 <= 0)
+		return keep_edge(0, 1, d12_1, d12_2);
+	if (d13_1 > 0 && d13_2 > 0 && d123_2 <= 0)
+		return keep_edge(0, 2, d13_1, d13_2);
+	if (d12_1 <= 0 && d23_2 <= 0)
+		return keep_vertex(1);
+	if (d13_1 <= 0 && d23_1 <= 0)
+		return keep_vertex(2);
+	if (d23_1 > 0 && d23_2 > 0 && d123_1 <= 0)
+		return keep_edge(1, 2, d23_1, d23_2);
+
+	float sum = d123_1 + d123_2 + d123_3;
+	v[0].bary = d123_1 / sum;
+	v[1].bary = d123_2 / sum;
+	v[2].bary = d123_3 / sum;
+	return false;
+}
+
+closest_points distance(const shape_view &a, const shape_view &b)
+{
+	constexpr int max_iterations = 32;
+	constexpr float epsilon = 1e-6f;
+
+	simplex_vertex v[3];
+	int count = 1;
+
+	glm::vec2 dir{1, 0};
+	v[0].a = a.support(dir);
+	v[0].b = b.support(-dir);
+	v[0].w = v[0].a - v[0].b;
+
+	bool overlap = false;
+	for (int i = 0; i < max_iterations; ++i)
+	{
+		if (!solve_simplex(v, count))
+		{
+			overlap = true;
+			break;
+		}
+
+		glm::vec2 closest{0, 0};
+		for (int k = 0; k < count; ++k)
+			closest += v[k].w * v[k].bary;
+
+		if (glm::dot(closest, closest) < epsilon * epsilon)
+			break; // touching
+
+		dir = -closest;
+		simplex_vertex next;
+		next.a = a.support(dir);
+		next.b = b.support(-dir);
+		next.w = next.a - next.b;
+
+		// no progress toward the origin, closest is on the boundary
+		if (glm::dot(next.w, dir) - glm::dot(closest, dir) <= epsilon * glm::length(dir))
+			break;
+
+		bool duplicate = false;
+		for (int k = 0; k < count; ++k)
+			duplicate |= v[k].w == next.w;
+		if (duplicate)
+			break;
+
+		v[count++] = next;
+	}
+
+	closest_points res{{0, 0}, {0, 0}, 0};
+	for (int k = 0; k < count; ++k)
+	{
+		res.a += v[k].a * v[k].bary;
+		res.b += v[k].b * v[k].bary;
+	}
+	res.dist = overlap ? 0 : glm::length(res.a - res.b);
+
+	return res;
+}
+
+// closest points between segments p1 q1 and p2 q2
+void segment_closest(glm::vec2 p1, glm::vec2 q1, glm::vec2 p2, glm::vec2 q2, glm::vec2 &c1, glm::vec2 &c2)
+{
+	constexpr float epsilon = 1e-12f;
+
+	glm::vec2 d1 = q1 - p1;
+	glm::vec2 d2 = q2 - p2;
+	glm::vec2 r = p1 - p2;
+	float a = glm::dot(d1, d1);
+	float e = glm::dot(d2, d2);
+	float f = glm::dot(d2, r);
+
+	float s, t;
+	if (a <= epsilon && e <= epsilon)
+		s = t = 0;
+	else if (a <= epsilon)
+	{
+		s = 0;
+		t = std::clamp(f / e, 0.f, 1.f);
+	}
+	else
+	{
+		float c = glm::dot(d1, r);
+		if (e <= epsilon)
+		{
+			t = 0;
+			s = std::clamp(-c / a, 0.f, 1.f);
+		}
+		else
+		{
+			float b = glm::dot(d1, d2);
+			float denom = a * e - b * b;
+
+			// parallel segments pick s = 0
+			s = denom > epsilon ? std::clamp((b * f - c * e) / denom, 0.f, 1.f) : 0.f;
+			t = (b * s + f) / e;
+
+			if (t < 0)
+			{
+				t = 0;
+				s = std::clamp(-c / a, 0.f, 1.f);
+			}
+			else if (t > 1)
+			{
+				t = 1;
+				s = std::clamp((b - c) / a, 0.f, 1.f);
+			}
+		}
+	}
+
+	c1 = p1 + d1 * s;
+	c2 = p2 + d2 * t;
+}
+
+// radius of the view in world space, false if the view isn't uniformly scaled
+bool world_radius(const shape_view &view, float &radius)
+{
+	if (!view.shape->rounded())
+	{
+		radius = 0;
+		return true;
 	}
+
+	radius = static_cast<const rounded_shape *>(view.shape)->radius();
+	for (auto v = &view; v; v = v->parent)
+	{
+		if (std::abs(v->scale.x) != std::abs(v->scale.y))
+			return false;
+		radius *= std::abs(v->scale.x);
+	}
+
+	return true;
+}
+
+// one of the shapes has a convex radius
+// if the cores don't overlap the collision comes from their closest points, otherwise falls back to epa
+collision rounded_collides(const shape_view &a, const shape_view &b)
+{
+	constexpr float epsilon = 1e-6f;
+
+	float a_radius, b_radius;
+	if (!world_radius(a, a_radius) || !world_radius(b, b_radius))
+		return convex_collides(a, b);
+
+	shape_view a_core = a;
+	shape_view b_core = b;
+	if (a.shape->rounded())
+		a_core.shape = &static_cast<const rounded_shape *>(a.shape)->core();
+	if (b.shape->rounded())
+		b_core.shape = &static_cast<const rounded_shape *>(b.shape)->core();
+
+	glm::vec2 a_pt, b_pt;
+	if (a.shape->rounded() && b.shape->rounded() &&
+		static_cast<const rounded_shape *>(a.shape)->capsule() && static_cast<const rounded_shape *>(b.shape)->capsule())
+	{
+		auto a_seg = static_cast<const abstract_polygon *>(a_core.shape);
+		auto b_seg = static_cast<const abstract_polygon *>(b_core.shape);
+		segment_closest(a_core.to_world(a_seg->point(0)), a_core.to_world(a_seg->point(1)),
+						b_core.to_world(b_seg->point(0)), b_core.to_world(b_seg->point(1)), a_pt, b_pt);
+	}
+	else
+	{
+		auto closest = distance(a_core, b_core);
+		a_pt = closest.a;
+		b_pt = closest.b;
+	}
+
+	glm::vec2 ab = b_pt - a_pt;
+	float dist2 = glm::dot(ab, ab);
+	float total = a_radius + b_radius;
+	if (dist2 >= total * total)
+		return {};
+
+	// the cores overlap, so there is no separating direction between them
+	float dist = std::sqrt(dist2);
+	if (dist < epsilon)
+		return convex_collides(a, b);
+
+	glm::vec2 normal = ab / dist;
+	collision res{normal, total - dist, a_pt + normal * a_radius, b_pt - normal * b_radius};
+	fill_manifold(res, a_core, b_core, a_radius, b_radius);
+	return res;
+}
+
+// point on the side of body facing dir whose projection on along is at, facing is the body's outward normal there
+// the support direction is bisected between -along and along, which moves its point monotonically along that side
+static glm::vec2 boundary_at(const shape_view &body, glm::vec2 dir, glm::vec2 along, float at, glm::vec2 &facing)
+{
+	facing = dir;
+	glm::vec2 lo = body.support(-along), hi = body.support(along);
+	if (glm::dot(lo, along) >= at)
+		return lo;
+	if (glm::dot(hi, along) <= at)
+		return hi;
+
+	float lo_angle = -glm::pi<float>() / 2, hi_angle = glm::pi<float>() / 2;
+	for (int i = 0; i < 24; ++i)
+	{
+		float angle = (lo_angle + hi_angle) / 2;
+		glm::vec2 pt = body.support(dir * std::cos(angle) + along * std::sin(angle));
+		if (glm::dot(pt, along) < at)
+		{
+			lo = pt;
+			lo_angle = angle;
+		}
+		else
+		{
+			hi = pt;
+			hi_angle = angle;
+		}
+	}
+
+	float angle = (lo_angle + hi_angle) / 2;
+	facing = dir * std::cos(angle) + along * std::sin(angle);
+
+	// lo and hi end up on the same edge of a polygon, curves are close enough to straight between them
+	float l = glm::dot(lo, along), h = glm::dot(hi, along);
+	return h - l > 1e-9f ? lo + (hi - lo) * ((at - l) / (h - l)) : lo;
+}
+
+// segment piece of a one sided composite against body
+// the normal is the segment's normal, and the depth how far body reaches behind the segment
+// except where only the segment's end touches, see below
+collision segment_collides(const shape_view &body, const shape_view &segment, bool segment_is_b)
+{
+	auto seg = static_cast<const abstract_polygon *>(segment.shape);
+	auto composite = static_cast<const abstract_composite *>(segment.parent->shape);
+
+	// the segment in the composite's space
+	glm::vec2 local_p = segment.transform(seg->point(0));
+	glm::vec2 local_q = segment.transform(seg->point(1));
+	float local_len = glm::length(local_q - local_p);
+	if (local_len <= 0)
+		return {};
+
+	glm::vec2 p = segment.parent->to_world(local_p);
+	glm::vec2 q = segment.parent->to_world(local_q);
+
+	glm::vec2 pq = q - p;
+	float len = glm::length(pq);
+	if (len <= 0)
+		return {};
+
+	// points to the free side
+	glm::vec2 normal{-pq.y / len, pq.x / len};
+
+	glm::vec2 deepest = body.support(-normal);
+	if (glm::dot(p - deepest, normal) <= 0)
+		return {};
+
+	// the body has to reach behind the segment, within its extent and thickness
+	// a body already past the segment still collides, so it's pushed back out instead of falling through
+	glm::vec2 behind = glm::vec2{local_q.y - local_p.y, local_p.x - local_q.x} / local_len * composite->thickness();
+	polygon<4> solid = {p, segment.parent->to_world(local_p + behind), segment.parent->to_world(local_q + behind), q};
+	if (!overlaps(body, shape_view(solid)))
+		return {};
+
+	// past its ends the segment's line no longer bounds the solid part, there the end pokes into the body instead
+	// and the contact is along the body's normal where it crosses the end, so a body lying on the next segment isn't tipped
+	// a corner about at the end still touches the segment itself, the body's normal isn't defined there
+	constexpr float slop = .005f;
+	glm::vec2 tangent = pq / len;
+	float along = glm::dot(deepest - p, tangent);
+	glm::vec2 on_segment;
+	float depth;
+	if (along < -slop || along > len + slop)
+	{
+		on_segment = along < 0 ? p : q;
+		glm::vec2 facing;
+		glm::vec2 crossing = boundary_at(body, -normal, tangent, glm::dot(on_segment, tangent), facing);
+		normal = -facing;
+		depth = glm::dot(on_segment - crossing, normal);
+		deepest = on_segment - normal * depth;
+	}
+	else
+	{
+		depth = glm::dot(p - deepest, normal);
+		on_segment = deepest + normal * depth;
+	}
+	if (depth <= 0)
+		return {};
+
+	collision res = segment_is_b ? collision{-normal, depth, deepest, on_segment} : collision{normal, depth, on_segment, deepest};
+
+	float radius;
+	if (body.shape->rounded() && world_radius(body, radius))
+	{
+		shape_view core = body;
+		core.shape = &static_cast<const rounded_shape *>(body.shape)->core();
+		if (segment_is_b)
+			fill_manifold(res, core, segment, radius, 0);
+		else
+			fill_manifold(res, segment, core, 0, radius);
+	}
+	else if (segment_is_b)
+		fill_manifold(res, body, segment);
+	else
+		fill_manifold(res, segment, body);
+
+	// a lone corner past the end touches at the end instead
+	for (unsigned int i = 0; i < res.point_count; ++i)
+		if (float t = glm::dot(res.points[i] - p, tangent); t < -slop || t > len + slop)
+		{
+			res.points[i] = deepest + normal * (depth / 2);
+			res.depths[i] = depth;
+		}
+
+	return res;
+}
+
+// tests the pieces of composite near other, keeping the deepest collision
+// if flipped, composite is shape "b"
+collision composite_collides(const shape_view &composite, const shape_view &other, bool flipped)
+{
+	// pieces are appended by every level of a nested composite, so only this level's range is used
+	thread_local std::vector<shape_view> pieces;
+	std::size_t first = pieces.size();
+
+	static_cast<const abstract_composite *>(composite.shape)->query(composite.to_local(other.bounds()), pieces);
+	std::size_t last = pieces.size();
+
+	bool one_sided = static_cast<const abstract_composite *>(composite.shape)->one_sided();
+
+	collision deepest;
+	for (std::size_t i = first; i < last; ++i)
+	{
+		shape_view piece = pieces[i];
+		piece.parent = &composite;
+
+		collision res;
+		if (one_sided)
+			res = segment_collides(other, piece, flipped);
+		else
+			res = flipped ? collides(other, piece) : collides(piece, other);
+		if (res && (!deepest || res.dist > deepest.dist))
+			deepest = res;
+	}
+
+	pieces.erase(pieces.begin() + first, pieces.end());
+	return deepest;
+}
+
+// returns collision with mtv to get a out of b or false if no collision
+collision collides(const shape_view &a, const shape_view &b)
+{
+	if (a.shape->composite())
+		return composite_collides(a, b, false);
+	if (b.shape->composite())
+		return composite_collides(b, a, true);
+	if (a.shape->rounded() || b.shape->rounded())
+		return rounded_collides(a, b);
+
+	return convex_collides(a, b);
+}
+
+void piece_pairs(const shape_view &a, const shape_view &b, float margin, std::vector<piece_pair> &pairs)
+{
+	if (!a.shape->composite() && !b.shape->composite())
+	{
+		pairs.push_back({0, 0});
+		return;
+	}
+
+	// if flipped, composite is shape "b"
+	bool flipped = !a.shape->composite();
+	const shape_view &composite = flipped ? b : a;
+	const shape_view &other = flipped ? a : b;
+	auto shape = static_cast<const abstract_composite *>(composite.shape);
+
+	// pieces are appended by every level of a nested composite, so only this level's range is used
+	thread_local std::vector<shape_view> pieces;
+	std::size_t first = pieces.size();
+
+	shape->query(composite.to_local(other.bounds().fatten(margin)), pieces);
+	std::size_t last = pieces.size();
+
+	for (std::size_t i = first; i < last; ++i)
+	{
+		shape_view piece = pieces[i];
+		piece.parent = &composite;
+
+		std::size_t begin = pairs.size();
+		if (flipped)
+			piece_pairs(other, piece, margin, pairs);
+		else
+			piece_pairs(piece, other, margin, pairs);
+		for (std::size_t j = begin; j < pairs.size(); ++j)
+		{
+			std::uint32_t &id = flipped ? pairs[j].b : pairs[j].a;
+			id = piece.index + shape->size() * id;
+		}
+	}
+
+	pieces.erase(pieces.begin() + first, pieces.end());
+}
+
+// true for the segments of a one sided composite
+static bool one_sided_piece(const shape_view &view)
+{
+	return view.parent && static_cast<const abstract_composite *>(view.parent->shape)->one_sided();
+}
+
+// calls f with the convex piece of view numbered id, see piece_pairs
+template <typename F>
+static collision with_piece(const shape_view &view, std::uint32_t id, F &&f)
+{
+	if (!view.shape->composite())
+		return f(view);
+
+	auto shape = static_cast<const abstract_composite *>(view.shape);
+	shape_view piece = shape->piece(id % shape->size());
+	piece.parent = &view;
+	return with_piece(piece, id / shape->size(), f);
+}
+
+collision collides(const shape_view &a, const shape_view &b, piece_pair pieces)
+{
+	collision res = with_piece(a, pieces.a, [&](const shape_view &a_piece)
+	{
+		return with_piece(b, pieces.b, [&](const shape_view &b_piece)
+		{
+			bool a_segment = one_sided_piece(a_piece), b_segment = one_sided_piece(b_piece);
+			if (a_segment && b_segment)
+				return collision{};
+			if (a_segment)
+				return segment_collides(b_piece, a_piece, false);
+			if (b_segment)
+				return segment_collides(a_piece, b_piece, true);
+			return collides(a_piece, b_piece);
+		});
+	});
+
+	res.piece_a = pieces.a;
+	res.piece_b = pieces.b;
+	return res;
+}
+
+void collides(const shape_view &a, const shape_view &b, std::vector<collision> &manifolds)
+{
+	thread_local std::vector<piece_pair> pairs;
+	pairs.clear();
+	piece_pairs(a, b, 0, pairs);
+
+	for (auto pieces : pairs)
+		if (auto res = collides(a, b, pieces))
+			manifolds.push_back(std::move(res));
+}
+
+// true if any piece of composite near other overlaps it
+bool composite_overlaps(const shape_view &composite, const shape_view &other)
+{
+	thread_local std::vector<shape_view> pieces;
+	std::size_t first = pieces.size();
+
+	static_cast<const abstract_composite *>(composite.shape)->query(composite.to_local(other.bounds()), pieces);
+	std::size_t last = pieces.size();
+
+	bool res = false;
+	for (std::size_t i = first; i < last && !res; ++i)
+	{
+		shape_view piece = pieces[i];
+		piece.parent = &composite;
+		res = overlaps(piece, other);
+	}
+
+	pieces.erase(pieces.begin() + first, pieces.end());
+	return res;
+}
+
+bool overlaps(const shape_view &a, const shape_view &b)
+{
+	if (a.shape->composite())
+		return composite_overlaps(a, b);
+	if (b.shape->composite())
+		return composite_overlaps(b, a);
+
+	float a_radius, b_radius;
+	if ((a.shape->rounded() || b.shape->rounded()) && world_radius(a, a_radius) && world_radius(b, b_radius))
+	{
+		shape_view a_core = a;
+		shape_view b_core = b;
+		if (a.shape->rounded())
+			a_core.shape = &static_cast<const rounded_shape *>(a.shape)->core();
+		if (b.shape->rounded())
+			b_core.shape = &static_cast<const rounded_shape *>(b.shape)->core();
+
+		return distance(a_core, b_core).dist < a_radius + b_radius;
+	}
+
+	thread_local std::vector<glm::vec2> simplex(3);
+	return gjk(a, b, simplex);
 }
 
 // TODO
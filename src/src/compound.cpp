@@ -0,0 +1,38 @@
+#include "compound.h"
+
+PHYSICS_BEG
+
+void compound_shape::add_child(const abstract_shape &shape, glm::vec2 offset, glm::vec2 scale, float angle)
+{
+	shape_view &view = m_children.emplace_back(shape, offset, scale, angle);
+	view.index = static_cast<length_type>(m_children.size() - 1);
+	m_tree.insert(view.bounds(), static_cast<std::uint32_t>(m_children.size() - 1));
+
+	m_center = (m_center * float(m_children.size() - 1) + view.center()) / (float)m_children.size();
+}
+
+void compound_shape::add_child(std::unique_ptr<abstract_shape> shape, glm::vec2 offset, glm::vec2 scale, float angle)
+{
+	add_child(*shape, offset, scale, angle);
+	m_owned.push_back(std::move(shape));
+}
+
+void compound_shape::query(const bounding_box &box, std::vector<shape_view> &pieces) const
+{
+	m_tree.query(box, [&](std::uint32_t i) { pieces.push_back(m_children[i]); });
+}
+
+glm::vec2 compound_shape::support(glm::vec2 dir) const
+{
+	glm::vec2 res{0, 0};
+	float max = -std::numeric_limits<float>::infinity();
+	for (const auto &c : m_children)
+		if (auto pt = c.support(dir); glm::dot(pt, dir) > max)
+		{
+			max = glm::dot(pt, dir);
+			res = pt;
+		}
+	return res;
+}
+
+PHYSICS_END
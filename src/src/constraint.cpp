@@ -1,67 +1,120 @@
 #include "constraint.h"
+#include "wide.h"
 
 PHYSICS_BEG
 
-void position_constraint::update(float dt)
+// ropes only pull, so they skip the constraints that are shorter than their distance
+template <bool rope, typename T>
+static void update_distance(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const T> constraints, float bias_rate)
 {
-	glm::vec2 rel_pos = a->pt.pos - b->pt.pos;
-	float cur_dist = glm::length(rel_pos);
-	float delta = dist - cur_dist;
-	if (delta != 0)
+	for (const auto &c : constraints)
 	{
+		solver_body &a = bodies[c.a];
+		solver_body &b = bodies[c.b];
+
+		glm::vec2 rel_pos = positions[c.a] - positions[c.b];
+		float cur_dist = glm::length(rel_pos);
+		float delta = c.dist - cur_dist;
+		if (rope ? delta >= 0 : delta == 0)
+			continue;
+
 		glm::vec2 dir = glm::normalize(rel_pos);
-		glm::vec2 rel_vel = a->pt.v - b->pt.v;
+		glm::vec2 rel_vel = a.v - b.v;
 
-		float inv_mass = 1 / a->pt.m + 1 / b->pt.m;
+		float inv_mass = a.inv_m + b.inv_m;
 		if (inv_mass <= 0)
-			return;
+			continue;
 
 		float proj = glm::dot(rel_vel, dir);
 
-		float bias = -constraint::factor / dt * delta;
+		float bias = -bias_rate * delta;
 		float lagrange = -(proj + bias) / inv_mass;
 
-		a->pt.v += dir * lagrange / a->pt.m;
-		b->pt.v -= dir * lagrange / b->pt.m;
+		// constraints sharing a static object can run in parallel, so it is never written to
+		if (a.inv_m != 0)
+			a.v += dir * lagrange * a.inv_m;
+		if (b.inv_m != 0)
+			b.v -= dir * lagrange * b.inv_m;
 	}
 }
 
-void rope_constraint::update(float dt)
+// the scalar update above on wide_float::width constraints at a time, the rest go through the scalar one
+// bodies are gathered into lanes and scattered back, so no two constraints may share a dynamic body
+template <bool rope, typename T>
+static void update_distance_wide(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const T> constraints, float bias_rate)
 {
-	glm::vec2 rel_pos = a->pt.pos - b->pt.pos;
-	float cur_dist = glm::length(rel_pos);
-	float delta = dist - cur_dist;
-	if (delta < 0)
-	{
-		glm::vec2 dir = glm::normalize(rel_pos);
-		glm::vec2 rel_vel = a->pt.v - b->pt.v;
+	constexpr std::size_t width = wide_float::width;
+	std::size_t wide_count = constraints.size() / width * width;
 
-		float inv_mass = 1 / a->pt.m + 1 / b->pt.m;
-		if (inv_mass <= 0)
-			return;
+	alignas(32) float vax[width], vay[width], vbx[width], vby[width];
 
-		float proj = glm::dot(rel_vel, dir);
+	for (std::size_t i = 0; i < wide_count; i += width)
+	{
+		const T *group = &constraints[i];
+		auto lanes = [&](auto f) { return wide_float::gather([&](std::size_t l) { return f(group[l]); }); };
+
+		wide_float rx = lanes([&](const T &c) { return positions[c.a].x - positions[c.b].x; });
+		wide_float ry = lanes([&](const T &c) { return positions[c.a].y - positions[c.b].y; });
+		wide_float cur_dist = sqrt(rx * rx + ry * ry);
+		wide_float delta = lanes([](const T &c) { return c.dist; }) - cur_dist;
+		wide_float inv_a = lanes([&](const T &c) { return bodies[c.a].inv_m; });
+		wide_float inv_b = lanes([&](const T &c) { return bodies[c.b].inv_m; });
+		wide_float inv_mass = inv_a + inv_b;
+
+		wide_float active = (rope ? delta < 0.f : delta != 0.f) & (inv_mass > 0.f) & (cur_dist > 0.f);
+
+		// inactive lanes get harmless values instead of dividing by zero
+		wide_float inv_dist = select(active, 1.f / select(active, cur_dist, 1.f), 0.f);
+		wide_float dx = rx * inv_dist, dy = ry * inv_dist;
+
+		wide_float va_x = lanes([&](const T &c) { return bodies[c.a].v.x; });
+		wide_float va_y = lanes([&](const T &c) { return bodies[c.a].v.y; });
+		wide_float vb_x = lanes([&](const T &c) { return bodies[c.b].v.x; });
+		wide_float vb_y = lanes([&](const T &c) { return bodies[c.b].v.y; });
+		wide_float proj = (va_x - vb_x) * dx + (va_y - vb_y) * dy;
+
+		wide_float bias = -bias_rate * delta;
+		wide_float lagrange = select(active, (0.f - (proj + bias)) / select(active, inv_mass, 1.f), 0.f);
+
+		wide_float la = lagrange * inv_a, lb = lagrange * inv_b;
+		(va_x + dx * la).store(vax);
+		(va_y + dy * la).store(vay);
+		(vb_x - dx * lb).store(vbx);
+		(vb_y - dy * lb).store(vby);
+
+		// constraints sharing a static object can be in one lane group, so it is never written to
+		for (std::size_t l = 0; l < width; ++l)
+		{
+			if (bodies[group[l].a].inv_m != 0)
+				bodies[group[l].a].v = {vax[l], vay[l]};
+			if (bodies[group[l].b].inv_m != 0)
+				bodies[group[l].b].v = {vbx[l], vby[l]};
+		}
+	}
 
-		float bias = -constraint::factor / dt * delta;
-		float lagrange = -(proj + bias) / inv_mass;
+	update_distance<rope>(bodies, positions, constraints.subspan(wide_count), bias_rate);
+}
 
-		a->pt.v += dir * lagrange / a->pt.m;
-		b->pt.v -= dir * lagrange / b->pt.m;
-	}
+void update_constraints(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const position_constraint> constraints, float bias_rate)
+{
+	update_distance<false>(bodies, positions, constraints, bias_rate);
 }
 
-void collision_constraint::update(float dt)
+void update_constraints(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const rope_constraint> constraints, float bias_rate)
 {
-	// shape_view a_view(*a->poly, a->pt.pos, a->scale, a->pt.angle);
-	// shape_view b_view(*b->poly, b->pt.pos, b->scale, b->pt.angle);
+	update_distance<true>(bodies, positions, constraints, bias_rate);
+}
 
-	// auto res = collides(a_view, b_view);
-	// if (!res || (std::abs(res.mtv.x) < epsilon && std::abs(res.mtv.y) < epsilon))
-	// 	continue;
+const std::size_t wide_lanes = wide_float::width;
 
-	// auto manifold = contact_manifold(a_view, b_view, res);
+void update_constraints_wide(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const position_constraint> constraints, float bias_rate)
+{
+	update_distance_wide<false>(bodies, positions, constraints, bias_rate);
+}
 
-	// Eigen::Vector<float, 6> v(a->pt.v.x, a->pt.v.y, b->pt.v.x, b->pt.v.y, a->pt.w, b->pt.w);
+void update_constraints_wide(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const rope_constraint> constraints, float bias_rate)
+{
+	update_distance_wide<true>(bodies, positions, constraints, bias_rate);
 }
 
-PHYSICS_END
\ No newline at end of file
+PHYSICS_END
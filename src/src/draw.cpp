@@ -87,13 +87,12 @@ glm::dvec2 gl_instance::get_mouse_pos() const
 	return mouse_pos;
 }
 
-void draw_poly::draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec2 scale, float angle) const
+void draw_poly::draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const
 {
 	const auto &program = gl.get_shape_program();
 
 	glUseProgram(program.id);
 
-	auto model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), {pos, 0}), angle, {0, 0, 1}), {scale, 0});
 	auto model_view = gl.get_ortho() * model;
 	glUniformMatrix4fv(glGetUniformLocation(program.id, "model_view"), 1, GL_FALSE, &model_view[0][0]);
 	glUniform4fv(glGetUniformLocation(program.id, "color"), 1, &color[0]);
@@ -116,14 +115,42 @@ void draw_poly::init(const glm::vec2 *data)
 	glBindVertexArray(0);
 }
 
-void draw_circle::draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec2 scale, float angle) const
+void draw_lines::draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const
+{
+	const auto &program = gl.get_shape_program();
+
+	glUseProgram(program.id);
+
+	auto model_view = gl.get_ortho() * model;
+	glUniformMatrix4fv(glGetUniformLocation(program.id, "model_view"), 1, GL_FALSE, &model_view[0][0]);
+	glUniform4fv(glGetUniformLocation(program.id, "color"), 1, &color[0]);
+
+	glBindVertexArray(m_vao.id);
+	glDrawArrays(m_loop ? GL_LINE_LOOP : GL_LINE_STRIP, 0, static_cast<GLsizei>(m_size));
+}
+
+void draw_lines::init(const glm::vec2 *data)
+{
+	glBindVertexArray(m_vao.id);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo.id);
+	
+	glBufferData(GL_ARRAY_BUFFER, m_size * sizeof(glm::vec2), data, GL_STATIC_DRAW);
+	glVertexAttribPointer(pos_attribute, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+
+	glEnableVertexAttribArray(pos_attribute);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void draw_circle::draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const
 {
 	const auto &program = gl.get_circle_program();
 
 	glUseProgram(program.id);
 
-	auto model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), {pos, 0}), angle, {0, 0, 1}), {scale, 0});
 	auto model_view = gl.get_ortho() * model;
+	glm::vec2 scale{glm::length(glm::vec2(model[0])), glm::length(glm::vec2(model[1]))};
 	glm::vec2 trans_center(model_view * glm::vec4(0, 0, 0, 1));
 	glm::vec2 trans_radius = scale / glm::vec2(gl.target_size()) * 2.f;
 
@@ -136,6 +163,23 @@ void draw_circle::draw(gl_instance &gl, glm::vec4 color, glm::vec2 pos, glm::vec
 	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
 }
 
+draw_compound::draw_compound(const physics::compound_shape &shape)
+{
+	m_children.reserve(shape.size());
+	for (const auto &c : shape.children())
+	{
+		auto model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), {c.offset, 0}), c.angle(), {0, 0, 1}), {c.scale, 0});
+		m_children.push_back({make_shape(*c.shape), model});
+	}
+}
+
+void draw_compound::draw_model(gl_instance &gl, glm::vec4 color, const glm::mat4 &model) const
+{
+	for (const auto &c : m_children)
+		if (c.shape)
+			c.shape->draw_model(gl, color, model * c.model);
+}
+
 void gl_instance::framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	gl_instance *owner = static_cast<gl_instance *>(glfwGetWindowUserPointer(window));
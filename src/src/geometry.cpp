@@ -0,0 +1,354 @@
+#include "geometry.h"
+
+#include <algorithm>
+#include <numeric>
+
+PHYSICS_BEG
+
+float signed_area(std::span<const glm::vec2> outline)
+{
+	float area = 0;
+	for (std::size_t i = 0; i < outline.size(); ++i)
+		area += cross(outline[i], outline[(i + 1) % outline.size()]);
+	return area / 2;
+}
+
+bool is_convex(std::span<const glm::vec2> outline)
+{
+	bool pos = false, neg = false;
+	for (std::size_t i = 0; i < outline.size(); ++i)
+	{
+		glm::vec2 a = outline[i];
+		glm::vec2 b = outline[(i + 1) % outline.size()];
+		glm::vec2 c = outline[(i + 2) % outline.size()];
+
+		float turn = cross(b - a, c - b);
+		pos |= turn > 0;
+		neg |= turn < 0;
+	}
+
+	return !(pos && neg);
+}
+
+static float segment_distance(glm::vec2 p, glm::vec2 a, glm::vec2 b)
+{
+	glm::vec2 ab = b - a;
+	float len2 = glm::dot(ab, ab);
+	float t = len2 > 0 ? std::clamp(glm::dot(p - a, ab) / len2, 0.f, 1.f) : 0.f;
+	return glm::length(p - (a + ab * t));
+}
+
+std::vector<glm::vec2> remove_collinear(std::span<const glm::vec2> outline, float tolerance)
+{
+	std::size_t n = outline.size();
+	if (n <= 3)
+		return {outline.begin(), outline.end()};
+
+	// true if every original vertex between first and last is within tolerance of the segment first -> last
+	// measuring against the original vertices keeps the error from adding up over removed runs
+	auto within = [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t k = first + 1; k < last; ++k)
+			if (segment_distance(outline[k % n], outline[first % n], outline[last % n]) > tolerance)
+				return false;
+		return true;
+	};
+
+	std::vector<std::size_t> kept{0};
+	for (std::size_t anchor = 0;;)
+	{
+		std::size_t end = anchor + 1;
+		while (end + 1 <= n && within(anchor, end + 1))
+			++end;
+
+		// everything up to the first vertex is within tolerance
+		if (end >= n)
+			break;
+
+		kept.push_back(end);
+		anchor = end;
+	}
+
+	// the first vertex was kept unconditionally
+	if (kept.size() > 3 && within(kept.back(), kept[1] + n))
+		kept.erase(kept.begin());
+
+	std::vector<glm::vec2> res;
+	res.reserve(kept.size());
+	for (auto i : kept)
+		res.push_back(outline[i]);
+	return res;
+}
+
+// p inside or on the edge of counter clockwise triangle abc
+static bool in_triangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c)
+{
+	return cross(b - a, p - a) >= 0 && cross(c - b, p - b) >= 0 && cross(a - c, p - c) >= 0;
+}
+
+// merges two counter clockwise pieces sharing an edge if the result is convex
+static bool try_merge(const std::vector<glm::vec2> &pts, std::vector<std::uint32_t> &a, const std::vector<std::uint32_t> &b)
+{
+	for (std::size_t ai = 0; ai < a.size(); ++ai)
+	{
+		std::uint32_t i = a[ai];
+		std::uint32_t j = a[(ai + 1) % a.size()];
+
+		// the shared edge runs j -> i in b
+		auto bj = std::find(b.begin(), b.end(), j);
+		if (bj == b.end())
+			continue;
+		std::size_t bi = (bj - b.begin() + 1) % b.size();
+		if (b[bi] != i)
+			continue;
+
+		// a from j around to i, then b after i around to before j
+		std::vector<std::uint32_t> merged;
+		merged.reserve(a.size() + b.size() - 2);
+		for (std::size_t k = 0; k < a.size(); ++k)
+			merged.push_back(a[(ai + 1 + k) % a.size()]);
+		for (std::size_t k = 1; k + 1 < b.size(); ++k)
+			merged.push_back(b[(bi + k) % b.size()]);
+
+		// only the corners at the removed diagonal can become reflex
+		auto convex_at = [&](std::size_t k)
+		{
+			glm::vec2 prev = pts[merged[(k + merged.size() - 1) % merged.size()]];
+			glm::vec2 cur = pts[merged[k]];
+			glm::vec2 next = pts[merged[(k + 1) % merged.size()]];
+			return cross(cur - prev, next - cur) >= 0;
+		};
+
+		if (convex_at(0) && convex_at(a.size() - 1))
+		{
+			a = std::move(merged);
+			return true;
+		}
+
+		return false;
+	}
+
+	return false;
+}
+
+std::vector<std::vector<glm::vec2>> convex_decomposition(std::span<const glm::vec2> outline, float tolerance)
+{
+	auto pts = remove_collinear(outline, tolerance);
+	if (pts.size() < 3)
+		return {};
+
+	if (signed_area(pts) < 0)
+		std::reverse(pts.begin(), pts.end());
+
+	if (is_convex(pts))
+		return {pts};
+
+	// ear clipping
+	std::vector<std::vector<std::uint32_t>> pieces;
+	std::vector<std::uint32_t> remaining(pts.size());
+	std::iota(remaining.begin(), remaining.end(), 0);
+
+	while (remaining.size() > 3)
+	{
+		std::size_t m = remaining.size();
+		bool clipped = false;
+		for (std::size_t i = 0; i < m && !clipped; ++i)
+		{
+			std::uint32_t a = remaining[(i + m - 1) % m];
+			std::uint32_t b = remaining[i];
+			std::uint32_t c = remaining[(i + 1) % m];
+
+			// reflex or flat corner
+			if (cross(pts[b] - pts[a], pts[c] - pts[b]) <= 0)
+				continue;
+
+			bool ear = std::none_of(remaining.begin(), remaining.end(), [&](std::uint32_t v)
+			{
+				return v != a && v != b && v != c && in_triangle(pts[v], pts[a], pts[b], pts[c]);
+			});
+
+			if (ear)
+			{
+				pieces.push_back({a, b, c});
+				remaining.erase(remaining.begin() + i);
+				clipped = true;
+			}
+		}
+
+		// self intersecting outline, clip anyway so this terminates
+		if (!clipped)
+		{
+			pieces.push_back({remaining[m - 1], remaining[0], remaining[1]});
+			remaining.erase(remaining.begin());
+		}
+	}
+	pieces.push_back(std::move(remaining));
+
+	// Hertel-Mehlhorn, merging only makes corners wider so one pass is enough
+	for (std::size_t p = 0; p < pieces.size(); ++p)
+		for (std::size_t q = p + 1; q < pieces.size();)
+		{
+			if (try_merge(pts, pieces[p], pieces[q]))
+			{
+				pieces.erase(pieces.begin() + q);
+				q = p + 1;
+			}
+			else
+				++q;
+		}
+
+	std::vector<std::vector<glm::vec2>> res;
+	res.reserve(pieces.size());
+	for (const auto &piece : pieces)
+	{
+		auto &poly = res.emplace_back();
+		poly.reserve(piece.size());
+		for (auto i : piece)
+			poly.push_back(pts[i]);
+	}
+
+	return res;
+}
+
+compound_shape make_convex_decomposition(std::span<const glm::vec2> outline, float tolerance)
+{
+	compound_shape res;
+	for (const auto &piece : convex_decomposition(outline, tolerance))
+		res.add_child(std::make_unique<polygon<dynamic_size>>(piece), {0, 0}, {1, 1}, 0);
+	return res;
+}
+
+std::vector<glm::vec2> convex_hull(std::span<const glm::vec2> points)
+{
+	std::vector<glm::vec2> sorted(points.begin(), points.end());
+	std::sort(sorted.begin(), sorted.end(), [](glm::vec2 a, glm::vec2 b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	if (sorted.size() < 3)
+		return sorted;
+
+	std::vector<glm::vec2> hull(2 * sorted.size());
+	std::size_t k = 0;
+
+	// lower chain
+	for (auto pt : sorted)
+	{
+		while (k >= 2 && cross(hull[k - 1] - hull[k - 2], pt - hull[k - 1]) <= 0)
+			--k;
+		hull[k++] = pt;
+	}
+
+	// upper chain
+	for (std::size_t i = sorted.size() - 1, lower = k + 1; i-- > 0;)
+	{
+		glm::vec2 pt = sorted[i];
+		while (k >= lower && cross(hull[k - 1] - hull[k - 2], pt - hull[k - 1]) <= 0)
+			--k;
+		hull[k++] = pt;
+	}
+
+	// the first point was added again at the end
+	hull.resize(k - 1);
+	return hull;
+}
+
+std::vector<glm::vec2> simplify_convex(std::span<const glm::vec2> outline, float tolerance, std::size_t max_vertices, float *error)
+{
+	std::size_t n = outline.size();
+	if (error)
+		*error = 0;
+	if (n <= 3)
+		return {outline.begin(), outline.end()};
+
+	// doubly linked ring of the kept vertices
+	std::vector<std::size_t> prev(n), next(n);
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		prev[i] = (i + n - 1) % n;
+		next[i] = (i + 1) % n;
+	}
+
+	// error of removing i, the farthest original vertex between its neighbors from the new edge
+	// the outline is convex, so the farthest from the line is the farthest from the segment
+	auto removal_error = [&](std::size_t i)
+	{
+		glm::vec2 a = outline[prev[i]];
+		glm::vec2 edge = outline[next[i]] - a;
+		float len = glm::length(edge);
+
+		float res = 0;
+		for (std::size_t k = (prev[i] + 1) % n; k != next[i]; k = (k + 1) % n)
+			res = std::max(res, len > 0 ? cross(outline[k] - a, edge) / len : glm::length(outline[k] - a));
+		return res;
+	};
+
+	std::vector<float> cost(n);
+	std::vector<bool> removed(n);
+	for (std::size_t i = 0; i < n; ++i)
+		cost[i] = removal_error(i);
+
+	float max_error = 0;
+	for (std::size_t kept = n; kept > 3; --kept)
+	{
+		std::size_t best = n;
+		for (std::size_t i = 0; i < n; ++i)
+			if (!removed[i] && (best == n || cost[i] < cost[best]))
+				best = i;
+
+		if (cost[best] > tolerance && kept <= max_vertices)
+			break;
+
+		max_error = std::max(max_error, cost[best]);
+		removed[best] = true;
+		next[prev[best]] = next[best];
+		prev[next[best]] = prev[best];
+
+		cost[prev[best]] = removal_error(prev[best]);
+		cost[next[best]] = removal_error(next[best]);
+	}
+
+	if (error)
+		*error = max_error;
+
+	std::vector<glm::vec2> res;
+	for (std::size_t i = 0; i < n; ++i)
+		if (!removed[i])
+			res.push_back(outline[i]);
+	return res;
+}
+
+polygon<dynamic_size> make_hull(std::span<const glm::vec2> points, float tolerance, hull_stats *stats)
+{
+	auto hull = convex_hull(points);
+
+	float error;
+	auto simplified = simplify_convex(hull, tolerance, std::numeric_limits<std::size_t>::max(), &error);
+	if (stats)
+		*stats = {points.size(), hull.size(), simplified.size(), error};
+
+	return polygon<dynamic_size>(simplified);
+}
+
+const compound_shape &decomposition_cache::get(std::span<const glm::vec2> outline, float tolerance)
+{
+	std::size_t hash = std::hash<float>{}(tolerance);
+	for (auto pt : outline)
+	{
+		hash ^= std::hash<float>{}(pt.x) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<float>{}(pt.y) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	auto &bucket = m_entries[hash];
+	for (const auto &e : bucket)
+		if (e.tolerance == tolerance && std::ranges::equal(e.outline, outline))
+			return *e.shape;
+
+	auto shape = std::make_unique<compound_shape>(make_convex_decomposition(outline, tolerance));
+	auto &res = *shape;
+	bucket.push_back({std::vector<glm::vec2>(outline.begin(), outline.end()), tolerance, std::move(shape)});
+	++m_size;
+
+	return res;
+}
+
+PHYSICS_END
@@ -0,0 +1,420 @@
+#include "global_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PHYSICS_BEG
+
+using sparse_matrix = global_scratch::sparse_matrix;
+using row_bounds = global_scratch::row;
+
+namespace
+{
+	constexpr float unbounded = std::numeric_limits<float>::infinity();
+
+	// equalities of redundant constraints, like the joints of a closed loop, make the system singular
+	// this much of the diagonal added to it keeps the factorization going, with a negligible give
+	constexpr float regularization = 1e-5f;
+
+	class system_builder
+	{
+	public:
+		system_builder(std::span<const solver_body> bodies, std::span<const std::uint32_t> columns, global_scratch &scratch)
+			: m_bodies{bodies}, m_columns{columns}, m_scratch{scratch}
+		{
+			for (auto *block : {&scratch.equality, &scratch.bounded})
+			{
+				block->triplets.clear();
+				block->rows.clear();
+				block->rhs.clear();
+				block->diagonal.clear();
+			}
+		}
+
+		// adds a row of J with the linear and angular terms of a and b, target is the velocity J v it aims for
+		// rows without any bounds are equalities, returns the index of the row in its block or -1 if it can't move the bodies
+		std::int32_t add(std::uint32_t a, glm::vec2 lin_a, float ang_a, std::uint32_t b, glm::vec2 lin_b, float ang_b, float target,
+			row_bounds bounds)
+		{
+			const solver_body &body_a = m_bodies[a];
+			const solver_body &body_b = m_bodies[b];
+			float diagonal = mass_of(body_a, lin_a, ang_a) + mass_of(body_b, lin_b, ang_b);
+			if (diagonal <= 0)
+				return -1;
+
+			bool equality = bounds.lo == -unbounded && bounds.hi == unbounded && bounds.normal_row < 0 && !bounds.paired;
+			auto &block = equality ? m_scratch.equality : m_scratch.bounded;
+			auto row = static_cast<std::int32_t>(block.rows.size());
+			add_body(block, row, a, lin_a, ang_a);
+			add_body(block, row, b, lin_b, ang_b);
+
+			// kinematic bodies have no columns but can still move
+			float velocity = glm::dot(lin_a, body_a.v) + ang_a * body_a.w + glm::dot(lin_b, body_b.v) + ang_b * body_b.w;
+			block.rhs.push_back(target - velocity);
+			block.diagonal.push_back(diagonal);
+			block.rows.push_back(bounds);
+			return row;
+		}
+
+		// holds the points at ra on a and rb on b together, the impulse pushes b and pulls a like in the joints
+		void add_point(std::uint32_t a, glm::vec2 ra, std::uint32_t b, glm::vec2 rb, glm::vec2 bias, glm::vec2 &impulse)
+		{
+			add(a, {-1, 0}, ra.y, b, {1, 0}, -rb.y, -bias.x, {-unbounded, unbounded, &impulse.x});
+			add(a, {0, -1}, -ra.x, b, {0, 1}, rb.x, -bias.y, {-unbounded, unbounded, &impulse.y});
+		}
+
+		row_bounds &bounded_row(std::int32_t row) { return m_scratch.bounded.rows[static_cast<std::size_t>(row)]; }
+
+		// turns b relative to a
+		std::int32_t add_angular(std::uint32_t a, std::uint32_t b, float target, row_bounds bounds)
+		{
+			return add(a, {0, 0}, -1, b, {0, 0}, 1, target, bounds);
+		}
+
+	private:
+		static float mass_of(const solver_body &body, glm::vec2 lin, float ang)
+		{
+			return glm::dot(lin, lin) * body.inv_m + ang * ang * body.inv_I;
+		}
+
+		void add_body(global_scratch::block &block, std::int32_t row, std::uint32_t id, glm::vec2 lin, float ang)
+		{
+			// static bodies have no columns
+			if (m_bodies[id].inv_m == 0 && m_bodies[id].inv_I == 0)
+				return;
+
+			auto col = static_cast<int>(3 * m_columns[id]);
+			block.triplets.emplace_back(row, col, lin.x);
+			block.triplets.emplace_back(row, col + 1, lin.y);
+			block.triplets.emplace_back(row, col + 2, ang);
+		}
+
+		std::span<const solver_body> m_bodies;
+		std::span<const std::uint32_t> m_columns;
+		global_scratch &m_scratch;
+	};
+}
+
+static glm::vec2 tangent_of(glm::vec2 normal) { return {normal.y, -normal.x}; }
+
+// velocity towards a limit, like limit_impulse of the joints, one not reached yet is approached within the step
+static float limit_target(float gap, float dt, const softness &soft)
+{
+	return gap > 0 ? -gap / dt : -soft.bias_rate * gap;
+}
+
+// distance constraints in the form of update_constraints, their impulse pushes a along the direction from b to a
+template <bool rope, typename T>
+static void add_distance_rows(system_builder &builder, std::span<const solver_body> bodies, std::span<const glm::vec2> positions,
+	std::span<const T> constraints, float bias_rate)
+{
+	for (const auto &c : constraints)
+	{
+		const solver_body &a = bodies[c.a];
+		const solver_body &b = bodies[c.b];
+
+		glm::vec2 rel_pos = positions[c.a] - positions[c.b];
+		float cur_dist = glm::length(rel_pos);
+		float delta = c.dist - cur_dist;
+		if ((rope && delta >= 0) || cur_dist == 0 || a.inv_m + b.inv_m <= 0)
+			continue;
+
+		glm::vec2 dir = rel_pos / cur_dist;
+
+		// ropes only pull a towards b
+		builder.add(c.a, dir, 0, c.b, -dir, 0, bias_rate * delta, {-unbounded, rope ? 0 : unbounded});
+	}
+}
+
+// the rows of the joints follow their sequential impulses in joint.cpp, with the same signs and impulses
+static void add_joint_rows(system_builder &builder, std::span<revolute_joint> joints, float dt)
+{
+	for (auto &j : joints)
+	{
+		builder.add_point(j.a, j.ra, j.b, j.rb, j.bias, j.impulse);
+		if (j.motor)
+		{
+			float max = j.max_motor_torque * dt;
+			builder.add_angular(j.a, j.b, j.motor_speed, {-max, max, &j.motor_impulse});
+		}
+		if (j.limit)
+		{
+			builder.add_angular(j.a, j.b, limit_target(j.angle - j.lower_angle, dt, j.soft), {0, unbounded, &j.lower_impulse});
+			builder.add(j.a, {0, 0}, 1, j.b, {0, 0}, -1, limit_target(j.upper_angle - j.angle, dt, j.soft), {0, unbounded, &j.upper_impulse});
+		}
+	}
+}
+
+static void add_joint_rows(system_builder &builder, std::span<prismatic_joint> joints, float dt)
+{
+	for (auto &j : joints)
+	{
+		builder.add(j.a, -j.perp, -j.s1, j.b, j.perp, j.s2, -j.bias.x, {-unbounded, unbounded, &j.impulse.x});
+		builder.add_angular(j.a, j.b, -j.bias.y, {-unbounded, unbounded, &j.impulse.y});
+		if (j.motor)
+		{
+			float max = j.max_motor_force * dt;
+			builder.add(j.a, -j.axis, -j.a1, j.b, j.axis, j.a2, j.motor_speed, {-max, max, &j.motor_impulse});
+		}
+		if (j.limit)
+		{
+			builder.add(j.a, -j.axis, -j.a1, j.b, j.axis, j.a2, limit_target(j.translation - j.lower_translation, dt, j.soft),
+				{0, unbounded, &j.lower_impulse});
+			builder.add(j.a, j.axis, j.a1, j.b, -j.axis, -j.a2, limit_target(j.upper_translation - j.translation, dt, j.soft),
+				{0, unbounded, &j.upper_impulse});
+		}
+	}
+}
+
+static void add_joint_rows(system_builder &builder, std::span<weld_joint> joints, float)
+{
+	for (auto &j : joints)
+	{
+		builder.add_point(j.a, j.ra, j.b, j.rb, j.bias, j.impulse);
+		builder.add_angular(j.a, j.b, -j.angle_bias, {-unbounded, unbounded, &j.angular_impulse});
+	}
+}
+
+// the force is limited as a whole, so the two linear rows are a pair
+static void add_joint_rows(system_builder &builder, std::span<motor_joint> joints, float dt)
+{
+	for (auto &j : joints)
+	{
+		float max_torque = j.max_torque * dt;
+		builder.add_angular(j.a, j.b, -j.correction_factor * j.angular_error, {-max_torque, max_torque, &j.angular_impulse});
+
+		float max_force = j.max_force * dt;
+		glm::vec2 target = -j.correction_factor * j.linear_error;
+		builder.add(j.a, {-1, 0}, 0, j.b, {1, 0}, 0, target.x, {-max_force, max_force, &j.impulse.x});
+		builder.add(j.a, {0, -1}, 0, j.b, {0, 1}, 0, target.y, {-max_force, max_force, &j.impulse.y, -1, 0, true});
+	}
+}
+
+
+// both normal impulses of a two point contact, the linear complementarity problem of solve_block in solver.cpp
+// error is how far the velocities along the rows are from what they have to make, with the impulses at old
+static glm::vec2 solve_block(const contact_constraint &c, glm::vec2 old, glm::vec2 error)
+{
+	// velocities with the current impulses taken out
+	glm::vec2 rhs{
+		error.x - (c.k[0][0] * old.x + c.k[0][1] * old.y),
+		error.y - (c.k[1][0] * old.x + c.k[1][1] * old.y)
+	};
+
+	// both points active
+	glm::vec2 x{
+		-(c.normal_mass[0][0] * rhs.x + c.normal_mass[0][1] * rhs.y),
+		-(c.normal_mass[1][0] * rhs.x + c.normal_mass[1][1] * rhs.y)
+	};
+	if (x.x >= 0 && x.y >= 0)
+		return x;
+
+	// only the first point active
+	x = {-rhs.x / c.k[0][0], 0};
+	if (x.x >= 0 && c.k[1][0] * x.x + rhs.y >= 0)
+		return x;
+
+	// only the second point active
+	x = {0, -rhs.y / c.k[1][1]};
+	if (x.y >= 0 && c.k[0][1] * x.y + rhs.x >= 0)
+		return x;
+
+	// both separating
+	if (rhs.x >= 0 && rhs.y >= 0)
+		return {0, 0};
+
+	// no case fits because of round off, leave the impulses as they are
+	return old;
+}
+
+// M^-1 J^T lambda, the velocity change of the bodies by the impulses of a block
+static void update_change(global_scratch::block &block, const Eigen::VectorXf &inv_mass)
+{
+	block.change = inv_mass.cwiseProduct(block.jacobian.transpose() * block.lambda);
+}
+
+// the pattern of the equalities only changes when constraints or joints come and go, otherwise the analysis is kept
+static void factorize(global_scratch &scratch)
+{
+	const auto &system = scratch.system;
+	auto outer = std::span(system.outerIndexPtr(), static_cast<std::size_t>(system.outerSize() + 1));
+	auto inner = std::span(system.innerIndexPtr(), static_cast<std::size_t>(system.nonZeros()));
+	auto &pattern = scratch.pattern;
+	if (!scratch.factorization)
+	{
+		scratch.factorization = std::make_unique<Eigen::SimplicialLDLT<Eigen::SparseMatrix<float>>>();
+		pattern.clear();
+	}
+	if (pattern.size() != outer.size() + inner.size() || !std::equal(outer.begin(), outer.end(), pattern.begin())
+		|| !std::equal(inner.begin(), inner.end(), pattern.begin() + outer.size()))
+	{
+		scratch.factorization->analyzePattern(system);
+		pattern.assign(outer.begin(), outer.end());
+		pattern.insert(pattern.end(), inner.begin(), inner.end());
+	}
+	scratch.factorization->factorize(system);
+}
+
+global_result solve_global(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const std::uint32_t> ids,
+	std::span<std::uint32_t> columns, std::span<contact_constraint> contacts, std::span<const position_constraint> position_constraints,
+	std::span<const rope_constraint> rope_constraints, island_joints joints, float bias_rate, float dt, int iterations, float tolerance,
+	global_scratch &scratch)
+{
+	for (std::uint32_t i = 0; i < ids.size(); ++i)
+		columns[ids[i]] = i;
+
+	system_builder builder(bodies, columns, scratch);
+
+	// the rows follow J v = b.v - a.v along the direction at the points, like the sequential impulses
+	for (auto &c : contacts)
+	{
+		std::int32_t normals[2] = {-1, -1};
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			contact_point &p = c.points[i];
+			normals[i] = builder.add(c.a, -c.normal, -cross(p.ra, c.normal), c.b, c.normal, cross(p.rb, c.normal),
+				std::max(p.bias, p.push), {0, unbounded, &p.normal_impulse});
+		}
+		// the rows are rigid, so only blocks without a softened diagonal
+		if (c.block && c.points[0].mass_scale == 1 && c.points[1].mass_scale == 1 && normals[0] >= 0 && normals[1] == normals[0] + 1)
+			builder.bounded_row(normals[0]).block = &c;
+
+		glm::vec2 tangent = tangent_of(c.normal);
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			contact_point &p = c.points[i];
+			if (normals[i] >= 0)
+				builder.add(c.a, -tangent, -cross(p.ra, tangent), c.b, tangent, cross(p.rb, tangent), 0,
+					{0, 0, &p.tangent_impulse, normals[i], c.friction});
+		}
+	}
+	add_distance_rows<false>(builder, bodies, positions, position_constraints, bias_rate);
+	add_distance_rows<true>(builder, bodies, positions, rope_constraints, bias_rate);
+	add_joint_rows(builder, joints.revolute, dt);
+	add_joint_rows(builder, joints.prismatic, dt);
+	add_joint_rows(builder, joints.weld, dt);
+	add_joint_rows(builder, joints.motor, dt);
+
+	auto col_count = static_cast<Eigen::Index>(3 * ids.size());
+	scratch.inv_mass.resize(col_count);
+	for (std::uint32_t i = 0; i < ids.size(); ++i)
+	{
+		const solver_body &body = bodies[ids[i]];
+		scratch.inv_mass.segment<3>(3 * i) << body.inv_m, body.inv_m, body.inv_I;
+	}
+
+	// the impulses start from the last step, the equalities are solved from scratch anyway
+	for (auto *block : {&scratch.equality, &scratch.bounded})
+	{
+		auto row_count = static_cast<Eigen::Index>(block->rows.size());
+		block->jacobian.resize(row_count, col_count);
+		block->jacobian.setFromTriplets(block->triplets.begin(), block->triplets.end());
+		block->lambda.resize(row_count);
+		for (Eigen::Index r = 0; r < row_count; ++r)
+			block->lambda[r] = block->rows[r].impulse ? *block->rows[r].impulse : 0;
+		update_change(*block, scratch.inv_mass);
+	}
+
+	auto &equality = scratch.equality;
+	auto &bounded = scratch.bounded;
+	auto equality_count = static_cast<Eigen::Index>(equality.rows.size());
+	auto bounded_count = static_cast<Eigen::Index>(bounded.rows.size());
+	if (equality_count > 0)
+	{
+		scratch.system = equality.jacobian * scratch.inv_mass.asDiagonal() * equality.jacobian.transpose();
+		for (Eigen::Index r = 0; r < equality_count; ++r)
+			scratch.system.coeffRef(r, r) += regularization * equality.diagonal[r];
+		factorize(scratch);
+	}
+
+	global_result result{0, 0};
+	for (int it = 0; it < iterations; ++it)
+	{
+		float residual = 0;
+
+		// the equalities exactly, given what the bounded rows do
+		if (equality_count > 0)
+		{
+			scratch.rhs = Eigen::Map<const Eigen::VectorXf>(equality.rhs.data(), equality_count) - equality.jacobian * bounded.change;
+			Eigen::VectorXf lambda = scratch.factorization->solve(scratch.rhs);
+			residual = (lambda - equality.lambda).cwiseAbs().maxCoeff();
+			equality.lambda = lambda;
+			update_change(equality, scratch.inv_mass);
+		}
+
+		// then one projected gauss seidel sweep over the bounded rows, on the velocities both blocks give
+		auto velocity = [&](Eigen::Index r)
+		{
+			float v = 0;
+			for (sparse_matrix::InnerIterator e(bounded.jacobian, r); e; ++e)
+				v += e.value() * (equality.change[e.col()] + bounded.change[e.col()]);
+			return v;
+		};
+		auto apply = [&](Eigen::Index r, float impulse)
+		{
+			for (sparse_matrix::InnerIterator e(bounded.jacobian, r); e; ++e)
+				bounded.change[e.col()] += scratch.inv_mass[e.col()] * e.value() * impulse;
+			residual = std::max(residual, std::abs(impulse));
+		};
+		for (Eigen::Index r = 0; r < bounded_count; ++r)
+		{
+			const row_bounds &bounds = bounded.rows[r];
+			if (bounds.block)
+			{
+				glm::vec2 old{bounded.lambda[r], bounded.lambda[r + 1]};
+				glm::vec2 error{velocity(r) - bounded.rhs[r], velocity(r + 1) - bounded.rhs[r + 1]};
+				glm::vec2 x = solve_block(*bounds.block, old, error);
+				apply(r, x.x - old.x);
+				apply(r + 1, x.y - old.y);
+				bounded.lambda[r] = x.x;
+				bounded.lambda[++r] = x.y;
+				continue;
+			}
+
+			float lo = bounds.lo, hi = bounds.hi;
+			if (bounds.normal_row >= 0)
+			{
+				hi = bounds.friction * bounded.lambda[bounds.normal_row];
+				lo = -hi;
+			}
+
+			float &lambda = bounded.lambda[r];
+			float old = lambda;
+			lambda = std::clamp(lambda + (bounded.rhs[r] - velocity(r)) / bounded.diagonal[r], lo, hi);
+			apply(r, lambda - old);
+
+			// a pair of rows is scaled back together once its impulse is too long
+			float length = bounds.paired ? std::hypot(bounded.lambda[r - 1], lambda) : 0;
+			if (length > hi)
+			{
+				float scale = hi / length;
+				apply(r - 1, bounded.lambda[r - 1] * (scale - 1));
+				apply(r, lambda * (scale - 1));
+				bounded.lambda[r - 1] *= scale;
+				lambda *= scale;
+			}
+		}
+
+		++result.iterations;
+		result.residual = residual;
+		if (bounded_count == 0 || residual < tolerance)
+			break;
+	}
+
+	for (std::uint32_t i = 0; i < ids.size(); ++i)
+	{
+		solver_body &body = bodies[ids[i]];
+		auto dv = equality.change.segment<3>(3 * i) + bounded.change.segment<3>(3 * i);
+		body.v += glm::vec2{dv[0], dv[1]};
+		body.w += dv[2];
+	}
+
+	for (const auto *block : {&equality, &bounded})
+		for (std::size_t r = 0; r < block->rows.size(); ++r)
+			if (block->rows[r].impulse)
+				*block->rows[r].impulse = block->lambda[static_cast<Eigen::Index>(r)];
+	return result;
+}
+
+PHYSICS_END
@@ -0,0 +1,334 @@
+#include "joint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PHYSICS_BEG
+
+static constexpr float unbounded = std::numeric_limits<float>::infinity();
+
+// static bodies are shared between threads, so they are never written to
+// the linear impulse pushes b and pulls a, the angular ones are the torques on each
+static void apply_impulse(solver_body &a, solver_body &b, glm::vec2 impulse, float angular_a, float angular_b)
+{
+	if (a.inv_m != 0 || a.inv_I != 0)
+	{
+		a.v -= impulse * a.inv_m;
+		a.w -= a.inv_I * angular_a;
+	}
+	if (b.inv_m != 0 || b.inv_I != 0)
+	{
+		b.v += impulse * b.inv_m;
+		b.w += b.inv_I * angular_b;
+	}
+}
+
+static float inverse_or_zero(float x) { return x > 0 ? 1 / x : 0; }
+
+// mass matrix of holding the points at ra and rb together
+static void point_mass(const solver_body &a, const solver_body &b, glm::vec2 ra, glm::vec2 rb, float (&k)[2][2])
+{
+	float m = a.inv_m + b.inv_m;
+	k[0][0] = m + a.inv_I * ra.y * ra.y + b.inv_I * rb.y * rb.y;
+	k[0][1] = k[1][0] = -a.inv_I * ra.x * ra.y - b.inv_I * rb.x * rb.y;
+	k[1][1] = m + a.inv_I * ra.x * ra.x + b.inv_I * rb.x * rb.x;
+}
+
+// k^-1 * v, zero if k is singular
+static glm::vec2 solve(const float (&k)[2][2], glm::vec2 v)
+{
+	float det = inverse_or_zero(k[0][0] * k[1][1] - k[0][1] * k[1][0]);
+	return {det * (k[1][1] * v.x - k[0][1] * v.y), det * (k[0][0] * v.y - k[1][0] * v.x)};
+}
+
+// adds delta to the accumulated impulse, clamped to [lo, hi], and returns how much it actually changed
+static float accumulate(float &accumulated, float delta, float lo, float hi)
+{
+	float old = accumulated;
+	accumulated = std::clamp(old + delta, lo, hi);
+	return accumulated - old;
+}
+
+// largest change of either row of a point or angular pair
+static float largest(glm::vec2 change) { return std::max(std::abs(change.x), std::abs(change.y)); }
+
+// change of the impulse of a limit row with the relative velocity towards the limit
+// a limit that isn't reached yet lets the objects approach it within the step, a passed one is pushed back softly
+static float limit_impulse(float &accumulated, float mass, float velocity, float gap, float dt, const softness &soft)
+{
+	if (gap > 0)
+		return accumulate(accumulated, -mass * (velocity + gap / dt), 0, unbounded);
+	return accumulate(accumulated, -soft.mass_scale * mass * (velocity + soft.bias_rate * gap) - soft.impulse_scale * accumulated, 0, unbounded);
+}
+
+// relative velocity of the point at rb on b and the point at ra on a
+static glm::vec2 point_velocity(const solver_body &a, const solver_body &b, glm::vec2 ra, glm::vec2 rb)
+{
+	return b.v + cross(b.w, rb) - a.v - cross(a.w, ra);
+}
+
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<revolute_joint> joints, float dt, const solver_settings &settings)
+{
+	for (auto &j : joints)
+	{
+		const solver_body &a = bodies[j.a];
+		const solver_body &b = bodies[j.b];
+
+		j.soft = make_softness(settings.joint_hertz, settings.joint_damping_ratio, dt);
+		j.ra = rotate(j.local_a, angles[j.a]);
+		j.rb = rotate(j.local_b, angles[j.b]);
+		point_mass(a, b, j.ra, j.rb, j.k);
+		j.axial_mass = inverse_or_zero(a.inv_I + b.inv_I);
+		j.bias = j.soft.bias_rate * (positions[j.b] + j.rb - positions[j.a] - j.ra);
+		j.angle = angles[j.b] - angles[j.a] - j.reference_angle;
+
+		if (!settings.warm_starting)
+		{
+			j.impulse = {0, 0};
+			j.motor_impulse = j.lower_impulse = j.upper_impulse = 0;
+		}
+		if (!j.motor)
+			j.motor_impulse = 0;
+		if (!j.limit)
+			j.lower_impulse = j.upper_impulse = 0;
+	}
+}
+
+void warm_start_joints(std::span<solver_body> bodies, std::span<const revolute_joint> joints)
+{
+	for (const auto &j : joints)
+	{
+		float axial = j.motor_impulse + j.lower_impulse - j.upper_impulse;
+		apply_impulse(bodies[j.a], bodies[j.b], j.impulse, cross(j.ra, j.impulse) + axial, cross(j.rb, j.impulse) + axial);
+	}
+}
+
+float solve_joints(std::span<solver_body> bodies, std::span<revolute_joint> joints, float dt)
+{
+	float residual = 0;
+	for (auto &j : joints)
+	{
+		solver_body &a = bodies[j.a];
+		solver_body &b = bodies[j.b];
+
+		if (j.motor)
+		{
+			float max = j.max_motor_torque * dt;
+			float impulse = accumulate(j.motor_impulse, -j.axial_mass * (b.w - a.w - j.motor_speed), -max, max);
+			apply_impulse(a, b, {0, 0}, impulse, impulse);
+			residual = std::max(residual, std::abs(impulse));
+		}
+
+		if (j.limit)
+		{
+			float lower = limit_impulse(j.lower_impulse, j.axial_mass, b.w - a.w, j.angle - j.lower_angle, dt, j.soft);
+			apply_impulse(a, b, {0, 0}, lower, lower);
+
+			float upper = limit_impulse(j.upper_impulse, j.axial_mass, a.w - b.w, j.upper_angle - j.angle, dt, j.soft);
+			apply_impulse(a, b, {0, 0}, -upper, -upper);
+			residual = std::max({residual, std::abs(lower), std::abs(upper)});
+		}
+
+		glm::vec2 impulse = -j.soft.mass_scale * solve(j.k, point_velocity(a, b, j.ra, j.rb) + j.bias) - j.soft.impulse_scale * j.impulse;
+		j.impulse += impulse;
+		apply_impulse(a, b, impulse, cross(j.ra, impulse), cross(j.rb, impulse));
+		residual = std::max(residual, largest(impulse));
+	}
+	return residual;
+}
+
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<prismatic_joint> joints, float dt, const solver_settings &settings)
+{
+	for (auto &j : joints)
+	{
+		const solver_body &a = bodies[j.a];
+		const solver_body &b = bodies[j.b];
+
+		j.soft = make_softness(settings.joint_hertz, settings.joint_damping_ratio, dt);
+		glm::vec2 ra = rotate(j.local_a, angles[j.a]);
+		glm::vec2 rb = rotate(j.local_b, angles[j.b]);
+		glm::vec2 d = positions[j.b] + rb - positions[j.a] - ra;
+
+		j.axis = rotate(j.local_axis, angles[j.a]);
+		j.perp = {-j.axis.y, j.axis.x};
+		// the axis turns with a, so a's arm reaches to b's anchor
+		j.a1 = cross(d + ra, j.axis);
+		j.a2 = cross(rb, j.axis);
+		j.s1 = cross(d + ra, j.perp);
+		j.s2 = cross(rb, j.perp);
+
+		float m = a.inv_m + b.inv_m;
+		j.axial_mass = inverse_or_zero(m + a.inv_I * j.a1 * j.a1 + b.inv_I * j.a2 * j.a2);
+		j.k[0][0] = m + a.inv_I * j.s1 * j.s1 + b.inv_I * j.s2 * j.s2;
+		j.k[0][1] = j.k[1][0] = a.inv_I * j.s1 + b.inv_I * j.s2;
+		// two objects that can't turn still slide
+		j.k[1][1] = a.inv_I + b.inv_I == 0 ? 1 : a.inv_I + b.inv_I;
+
+		j.translation = glm::dot(j.axis, d);
+		j.bias = j.soft.bias_rate * glm::vec2{glm::dot(j.perp, d), angles[j.b] - angles[j.a] - j.reference_angle};
+
+		if (!settings.warm_starting)
+		{
+			j.impulse = {0, 0};
+			j.motor_impulse = j.lower_impulse = j.upper_impulse = 0;
+		}
+		if (!j.motor)
+			j.motor_impulse = 0;
+		if (!j.limit)
+			j.lower_impulse = j.upper_impulse = 0;
+	}
+}
+
+void warm_start_joints(std::span<solver_body> bodies, std::span<const prismatic_joint> joints)
+{
+	for (const auto &j : joints)
+	{
+		float axial = j.motor_impulse + j.lower_impulse - j.upper_impulse;
+		glm::vec2 impulse = j.axis * axial + j.perp * j.impulse.x;
+		apply_impulse(bodies[j.a], bodies[j.b], impulse, axial * j.a1 + j.impulse.x * j.s1 + j.impulse.y,
+			axial * j.a2 + j.impulse.x * j.s2 + j.impulse.y);
+	}
+}
+
+float solve_joints(std::span<solver_body> bodies, std::span<prismatic_joint> joints, float dt)
+{
+	float residual = 0;
+	for (auto &j : joints)
+	{
+		solver_body &a = bodies[j.a];
+		solver_body &b = bodies[j.b];
+
+		auto axial_velocity = [&] { return glm::dot(j.axis, b.v - a.v) + j.a2 * b.w - j.a1 * a.w; };
+		auto apply_axial = [&](float impulse)
+		{
+			apply_impulse(a, b, j.axis * impulse, impulse * j.a1, impulse * j.a2);
+			residual = std::max(residual, std::abs(impulse));
+		};
+
+		if (j.motor)
+		{
+			float max = j.max_motor_force * dt;
+			apply_axial(accumulate(j.motor_impulse, j.axial_mass * (j.motor_speed - axial_velocity()), -max, max));
+		}
+
+		if (j.limit)
+		{
+			apply_axial(limit_impulse(j.lower_impulse, j.axial_mass, axial_velocity(), j.translation - j.lower_translation, dt, j.soft));
+			apply_axial(-limit_impulse(j.upper_impulse, j.axial_mass, -axial_velocity(), j.upper_translation - j.translation, dt, j.soft));
+		}
+
+		glm::vec2 velocity{glm::dot(j.perp, b.v - a.v) + j.s2 * b.w - j.s1 * a.w, b.w - a.w};
+		glm::vec2 impulse = -j.soft.mass_scale * solve(j.k, velocity + j.bias) - j.soft.impulse_scale * j.impulse;
+		j.impulse += impulse;
+		apply_impulse(a, b, j.perp * impulse.x, impulse.x * j.s1 + impulse.y, impulse.x * j.s2 + impulse.y);
+		residual = std::max(residual, largest(impulse));
+	}
+	return residual;
+}
+
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<weld_joint> joints, float dt, const solver_settings &settings)
+{
+	for (auto &j : joints)
+	{
+		const solver_body &a = bodies[j.a];
+		const solver_body &b = bodies[j.b];
+
+		j.soft = make_softness(settings.joint_hertz, settings.joint_damping_ratio, dt);
+		j.ra = rotate(j.local_a, angles[j.a]);
+		j.rb = rotate(j.local_b, angles[j.b]);
+		point_mass(a, b, j.ra, j.rb, j.k);
+		j.axial_mass = inverse_or_zero(a.inv_I + b.inv_I);
+		j.bias = j.soft.bias_rate * (positions[j.b] + j.rb - positions[j.a] - j.ra);
+		j.angle_bias = j.soft.bias_rate * (angles[j.b] - angles[j.a] - j.reference_angle);
+
+		if (!settings.warm_starting)
+		{
+			j.impulse = {0, 0};
+			j.angular_impulse = 0;
+		}
+	}
+}
+
+void warm_start_joints(std::span<solver_body> bodies, std::span<const weld_joint> joints)
+{
+	for (const auto &j : joints)
+		apply_impulse(bodies[j.a], bodies[j.b], j.impulse, cross(j.ra, j.impulse) + j.angular_impulse, cross(j.rb, j.impulse) + j.angular_impulse);
+}
+
+float solve_joints(std::span<solver_body> bodies, std::span<weld_joint> joints, float)
+{
+	float residual = 0;
+	for (auto &j : joints)
+	{
+		solver_body &a = bodies[j.a];
+		solver_body &b = bodies[j.b];
+
+		float angular = -j.soft.mass_scale * j.axial_mass * (b.w - a.w + j.angle_bias) - j.soft.impulse_scale * j.angular_impulse;
+		j.angular_impulse += angular;
+		apply_impulse(a, b, {0, 0}, angular, angular);
+
+		glm::vec2 impulse = -j.soft.mass_scale * solve(j.k, point_velocity(a, b, j.ra, j.rb) + j.bias) - j.soft.impulse_scale * j.impulse;
+		j.impulse += impulse;
+		apply_impulse(a, b, impulse, cross(j.ra, impulse), cross(j.rb, impulse));
+		residual = std::max({residual, std::abs(angular), largest(impulse)});
+	}
+	return residual;
+}
+
+// motor joints act on the positions of the objects, so there are no arms
+void prepare_joints(std::span<const solver_body> bodies, std::span<const glm::vec2> positions, std::span<const float> angles,
+	std::span<motor_joint> joints, float, const solver_settings &settings)
+{
+	for (auto &j : joints)
+	{
+		const solver_body &a = bodies[j.a];
+		const solver_body &b = bodies[j.b];
+
+		j.linear_error = positions[j.b] - positions[j.a] - rotate(j.linear_offset, angles[j.a]);
+		j.angular_error = angles[j.b] - angles[j.a] - j.angular_offset;
+		j.linear_mass = inverse_or_zero(a.inv_m + b.inv_m);
+		j.axial_mass = inverse_or_zero(a.inv_I + b.inv_I);
+
+		if (!settings.warm_starting)
+		{
+			j.impulse = {0, 0};
+			j.angular_impulse = 0;
+		}
+	}
+}
+
+void warm_start_joints(std::span<solver_body> bodies, std::span<const motor_joint> joints)
+{
+	for (const auto &j : joints)
+		apply_impulse(bodies[j.a], bodies[j.b], j.impulse, j.angular_impulse, j.angular_impulse);
+}
+
+float solve_joints(std::span<solver_body> bodies, std::span<motor_joint> joints, float dt)
+{
+	float residual = 0;
+	for (auto &j : joints)
+	{
+		solver_body &a = bodies[j.a];
+		solver_body &b = bodies[j.b];
+
+		float max_torque = j.max_torque * dt;
+		float angular = accumulate(j.angular_impulse, -j.axial_mass * (b.w - a.w + j.correction_factor * j.angular_error), -max_torque, max_torque);
+		apply_impulse(a, b, {0, 0}, angular, angular);
+
+		// the force is limited as a whole, not per axis
+		float max_force = j.max_force * dt;
+		glm::vec2 old = j.impulse;
+		j.impulse -= j.linear_mass * (b.v - a.v + j.correction_factor * j.linear_error);
+		if (glm::dot(j.impulse, j.impulse) > max_force * max_force)
+			j.impulse = glm::normalize(j.impulse) * max_force;
+		apply_impulse(a, b, j.impulse - old, 0, 0);
+		residual = std::max({residual, std::abs(angular), largest(j.impulse - old)});
+	}
+	return residual;
+}
+
+PHYSICS_END
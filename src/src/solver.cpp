@@ -0,0 +1,434 @@
+#include "solver.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+PHYSICS_BEG
+
+std::uint32_t graph_coloring::add(std::uint32_t a, std::uint32_t b, bool a_static, bool b_static)
+{
+	std::uint64_t used = (a_static ? 0 : m_used[a]) | (b_static ? 0 : m_used[b]);
+	if (~used == 0)
+		return overflow_color;
+
+	auto color = static_cast<std::uint32_t>(std::countr_one(used));
+	if (!a_static)
+		m_used[a] |= std::uint64_t{1} << color;
+	if (!b_static)
+		m_used[b] |= std::uint64_t{1} << color;
+	return color;
+}
+
+void union_find::reset(std::size_t count)
+{
+	m_parent.resize(count);
+	std::iota(m_parent.begin(), m_parent.end(), 0);
+}
+
+std::uint32_t union_find::find(std::uint32_t x)
+{
+	// path halving
+	while (m_parent[x] != x)
+		x = m_parent[x] = m_parent[m_parent[x]];
+	return x;
+}
+
+void union_find::unite(std::uint32_t a, std::uint32_t b)
+{
+	a = find(a);
+	b = find(b);
+	if (a < b)
+		m_parent[b] = a;
+	else
+		m_parent[a] = b;
+}
+
+softness make_softness(float hertz, float damping_ratio, float dt)
+{
+	if (hertz == 0)
+		return {0, 1, 0};
+
+	float omega = 2 * glm::pi<float>() * hertz;
+	float a1 = 2 * damping_ratio + dt * omega;
+	float a2 = dt * omega * a1;
+	float a3 = 1 / (1 + a2);
+	return {omega / a1, a2 * a3, a3};
+}
+
+static glm::vec2 tangent_of(glm::vec2 normal) { return {normal.y, -normal.x}; }
+
+static glm::vec2 relative_velocity(const solver_body &a, const solver_body &b, const contact_point &p)
+{
+	return b.v + cross(b.w, p.rb) - a.v - cross(a.w, p.ra);
+}
+
+static void compute_masses(const solver_body &a, const solver_body &b, contact_constraint &c, const solver_settings &settings)
+{
+	glm::vec2 tangent = tangent_of(c.normal);
+	for (std::uint32_t i = 0; i < c.point_count; ++i)
+	{
+		contact_point &p = c.points[i];
+
+		float rn_a = cross(p.ra, c.normal), rn_b = cross(p.rb, c.normal);
+		float k_normal = a.inv_m + b.inv_m + a.inv_I * rn_a * rn_a + b.inv_I * rn_b * rn_b;
+		p.normal_mass = k_normal > 0 ? 1 / k_normal : 0;
+
+		float rt_a = cross(p.ra, tangent), rt_b = cross(p.rb, tangent);
+		float k_tangent = a.inv_m + b.inv_m + a.inv_I * rt_a * rt_a + b.inv_I * rt_b * rt_b;
+		p.tangent_mass = k_tangent > 0 ? 1 / k_tangent : 0;
+	}
+
+	c.block = false;
+	if (settings.block_solver && c.point_count == 2)
+	{
+		const contact_point &p1 = c.points[0];
+		const contact_point &p2 = c.points[1];
+
+		float rn1_a = cross(p1.ra, c.normal), rn1_b = cross(p1.rb, c.normal);
+		float rn2_a = cross(p2.ra, c.normal), rn2_b = cross(p2.rb, c.normal);
+		float m = a.inv_m + b.inv_m;
+
+		float k11 = m + a.inv_I * rn1_a * rn1_a + b.inv_I * rn1_b * rn1_b;
+		float k22 = m + a.inv_I * rn2_a * rn2_a + b.inv_I * rn2_b * rn2_b;
+		float k12 = m + a.inv_I * rn1_a * rn2_a + b.inv_I * rn1_b * rn2_b;
+		// softness adds k * impulse_scale / mass_scale to the diagonal, the velocity error the accumulated impulse leaves
+		k11 /= p1.mass_scale;
+		k22 /= p2.mass_scale;
+
+		// close points make the matrix almost singular, those stay with sequential impulses
+		constexpr float max_condition = 1000;
+		float det = k11 * k22 - k12 * k12;
+		if (k11 * k11 < max_condition * det)
+		{
+			c.block = true;
+			c.k[0][0] = k11;
+			c.k[0][1] = c.k[1][0] = k12;
+			c.k[1][1] = k22;
+			c.normal_mass[0][0] = k22 / det;
+			c.normal_mass[0][1] = c.normal_mass[1][0] = -k12 / det;
+			c.normal_mass[1][1] = k11 / det;
+		}
+	}
+}
+
+void prepare_contacts(std::span<const solver_body> bodies, std::span<contact_constraint> contacts, float dt, const solver_settings &settings)
+{
+	softness soft = make_softness(settings.contact_hertz, settings.contact_damping_ratio, dt);
+	for (auto &c : contacts)
+	{
+		const solver_body &a = bodies[c.a];
+		const solver_body &b = bodies[c.b];
+
+		// the faster of bouncing off and pushing the overlap apart, only the push is soft
+		// with position iterations the overlaps are left to them, pushing as well would tip resting bodies over time
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			contact_point &p = c.points[i];
+			float vn = glm::dot(relative_velocity(a, b, p), c.normal);
+			p.bias = vn < -settings.restitution_threshold ? -c.restitution * vn : 0;
+
+			float push = std::min(-soft.bias_rate * (p.separation + contact_slop), settings.contact_push_velocity);
+			bool pushing = settings.position_iterations == 0 && push > p.bias;
+			p.push = pushing ? push : 0;
+			p.mass_scale = pushing ? soft.mass_scale : 1;
+			p.impulse_scale = pushing ? soft.impulse_scale : 0;
+		}
+
+		compute_masses(a, b, c, settings);
+	}
+}
+
+// static bodies are shared between threads, so they are never written to
+static void apply_impulse(solver_body &a, solver_body &b, const contact_point &p, glm::vec2 impulse)
+{
+	if (a.inv_m != 0 || a.inv_I != 0)
+	{
+		a.v -= impulse * a.inv_m;
+		a.w -= a.inv_I * cross(p.ra, impulse);
+	}
+	if (b.inv_m != 0 || b.inv_I != 0)
+	{
+		b.v += impulse * b.inv_m;
+		b.w += b.inv_I * cross(p.rb, impulse);
+	}
+}
+
+void warm_start_contacts(std::span<solver_body> bodies, std::span<const contact_constraint> contacts)
+{
+	for (const auto &c : contacts)
+	{
+		glm::vec2 tangent = tangent_of(c.normal);
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			const contact_point &p = c.points[i];
+			apply_impulse(bodies[c.a], bodies[c.b], p, c.normal * p.normal_impulse + tangent * p.tangent_impulse);
+		}
+	}
+}
+
+// solves the linear complementarity problem of both normal impulses exactly
+// vn = K * x + b, with x >= 0, vn >= 0 and x * vn = 0, by trying each set of active points
+// https://box2d.org/files/ErinCatto_ModelingAndSolvingConstraints_GDC2009.pdf
+// returns the largest change of the two impulses
+static float solve_block(solver_body &a, solver_body &b, contact_constraint &c)
+{
+	contact_point &p1 = c.points[0];
+	contact_point &p2 = c.points[1];
+
+	glm::vec2 old{p1.normal_impulse, p2.normal_impulse};
+
+	// velocities with the current impulses taken out, k holds the softened diagonal so the part softness added goes back in
+	float vn1 = glm::dot(relative_velocity(a, b, p1), c.normal);
+	float vn2 = glm::dot(relative_velocity(a, b, p2), c.normal);
+	glm::vec2 rhs{
+		vn1 - std::max(p1.bias, p1.push) - (c.k[0][0] * (1 - p1.impulse_scale) * old.x + c.k[0][1] * old.y),
+		vn2 - std::max(p2.bias, p2.push) - (c.k[1][0] * old.x + c.k[1][1] * (1 - p2.impulse_scale) * old.y)
+	};
+
+	auto apply = [&](glm::vec2 x)
+	{
+		glm::vec2 d = x - old;
+		apply_impulse(a, b, p1, c.normal * d.x);
+		apply_impulse(a, b, p2, c.normal * d.y);
+		p1.normal_impulse = x.x;
+		p2.normal_impulse = x.y;
+		return std::max(std::abs(d.x), std::abs(d.y));
+	};
+
+	// both points active
+	glm::vec2 x{
+		-(c.normal_mass[0][0] * rhs.x + c.normal_mass[0][1] * rhs.y),
+		-(c.normal_mass[1][0] * rhs.x + c.normal_mass[1][1] * rhs.y)
+	};
+	if (x.x >= 0 && x.y >= 0)
+		return apply(x);
+
+	// only the first point active
+	x = {-rhs.x / c.k[0][0], 0};
+	if (x.x >= 0 && c.k[1][0] * x.x + rhs.y >= 0)
+		return apply(x);
+
+	// only the second point active
+	x = {0, -rhs.y / c.k[1][1]};
+	if (x.y >= 0 && c.k[0][1] * x.y + rhs.x >= 0)
+		return apply(x);
+
+	// both separating
+	if (rhs.x >= 0 && rhs.y >= 0)
+		return apply({0, 0});
+
+	// no case fits because of round off, leave the impulses as they are
+	return 0.f;
+}
+
+float solve_contacts(std::span<solver_body> bodies, std::span<contact_constraint> contacts)
+{
+	float residual = 0;
+	for (auto &c : contacts)
+	{
+		solver_body &a = bodies[c.a];
+		solver_body &b = bodies[c.b];
+		glm::vec2 tangent = tangent_of(c.normal);
+
+		// friction first, its limit comes from the normal impulse of the last iteration
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			contact_point &p = c.points[i];
+
+			float vt = glm::dot(relative_velocity(a, b, p), tangent);
+			float max_friction = c.friction * p.normal_impulse;
+			float impulse = std::clamp(p.tangent_impulse - vt * p.tangent_mass, -max_friction, max_friction);
+
+			apply_impulse(a, b, p, tangent * (impulse - p.tangent_impulse));
+			residual = std::max(residual, std::abs(impulse - p.tangent_impulse));
+			p.tangent_impulse = impulse;
+		}
+
+		if (c.block)
+		{
+			residual = std::max(residual, solve_block(a, b, c));
+			continue;
+		}
+
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			contact_point &p = c.points[i];
+
+			float vn = glm::dot(relative_velocity(a, b, p), c.normal);
+			float target = std::max(p.bias, p.push);
+			float impulse = std::max(p.normal_impulse - p.mass_scale * (vn - target) * p.normal_mass - p.impulse_scale * p.normal_impulse, 0.f);
+
+			apply_impulse(a, b, p, c.normal * (impulse - p.normal_impulse));
+			residual = std::max(residual, std::abs(impulse - p.normal_impulse));
+			p.normal_impulse = impulse;
+		}
+	}
+	return residual;
+}
+
+void relax_contacts(std::span<solver_body> bodies, std::span<contact_constraint> contacts, const solver_settings &settings)
+{
+	for (auto &c : contacts)
+	{
+		bool pushing = false;
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			contact_point &p = c.points[i];
+			pushing |= p.push != 0;
+			p.push = 0;
+			p.mass_scale = 1;
+			p.impulse_scale = 0;
+		}
+		if (pushing)
+			compute_masses(bodies[c.a], bodies[c.b], c, settings);
+	}
+	solve_contacts(bodies, contacts);
+}
+
+void solve_contact_positions(std::span<glm::vec2> positions, std::span<float> angles, std::span<const solver_body> bodies,
+	std::span<const contact_constraint> contacts)
+{
+	// fraction of the overlap corrected per pass, and the most a pass moves a point
+	constexpr float factor = .2f;
+	constexpr float max_correction = .2f;
+
+	for (const auto &c : contacts)
+	{
+		const solver_body &a = bodies[c.a];
+		const solver_body &b = bodies[c.b];
+		bool a_moves = a.inv_m != 0 || a.inv_I != 0, b_moves = b.inv_m != 0 || b.inv_I != 0;
+
+		for (std::uint32_t i = 0; i < c.point_count; ++i)
+		{
+			const contact_point &p = c.points[i];
+			glm::vec2 ra = rotate(p.local_a, angles[c.a]);
+			glm::vec2 rb = rotate(p.local_b, angles[c.b]);
+			float separation = glm::dot(positions[c.b] + rb - positions[c.a] - ra, c.normal);
+
+			float error = std::clamp(factor * (separation + contact_slop), -max_correction, 0.f);
+			float rn_a = cross(ra, c.normal), rn_b = cross(rb, c.normal);
+			float k = a.inv_m + b.inv_m + a.inv_I * rn_a * rn_a + b.inv_I * rn_b * rn_b;
+			if (error == 0 || k <= 0)
+				continue;
+
+			glm::vec2 impulse = c.normal * (-error / k);
+			if (a_moves)
+			{
+				positions[c.a] -= impulse * a.inv_m;
+				angles[c.a] -= a.inv_I * cross(ra, impulse);
+			}
+			if (b_moves)
+			{
+				positions[c.b] += impulse * b.inv_m;
+				angles[c.b] += b.inv_I * cross(rb, impulse);
+			}
+		}
+	}
+}
+
+static bool is_static(const solver_body &b) { return b.inv_m == 0 && b.inv_I == 0; }
+
+void order_by_level(std::span<const solver_body> bodies, std::span<const contact_constraint> contacts, std::span<std::uint32_t> levels,
+	level_scratch &scratch)
+{
+	auto level = [&](std::uint32_t id) { return is_static(bodies[id]) ? 0 : levels[id]; };
+	auto &[touching, queue, order] = scratch;
+
+	// contacts by the dynamic bodies they touch
+	touching.clear();
+	for (std::uint32_t i = 0; i < contacts.size(); ++i)
+		for (auto id : {contacts[i].a, contacts[i].b})
+			if (!is_static(bodies[id]))
+			{
+				levels[id] = no_level;
+				touching.emplace_back(id, i);
+			}
+	std::sort(touching.begin(), touching.end());
+
+	// breadth first from the bodies resting on static ones
+	queue.clear();
+	for (const auto &c : contacts)
+		for (auto [id, other] : {std::pair(c.a, c.b), std::pair(c.b, c.a)})
+			if (is_static(bodies[other]) && levels[id] == no_level)
+			{
+				levels[id] = 1;
+				queue.push_back(id);
+			}
+	for (std::size_t head = 0; head < queue.size(); ++head)
+	{
+		std::uint32_t id = queue[head];
+		auto it = std::lower_bound(touching.begin(), touching.end(), std::pair(id, std::uint32_t{0}));
+		for (; it != touching.end() && it->first == id; ++it)
+		{
+			const contact_constraint &c = contacts[it->second];
+			std::uint32_t other = c.a == id ? c.b : c.a;
+			if (level(other) == no_level)
+			{
+				levels[other] = levels[id] + 1;
+				queue.push_back(other);
+			}
+		}
+	}
+
+	order.clear();
+	for (std::uint32_t i = 0; i < contacts.size(); ++i)
+		if (std::min(level(contacts[i].a), level(contacts[i].b)) != no_level)
+			order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), [&](std::uint32_t l, std::uint32_t r)
+	{
+		return std::min(level(contacts[l].a), level(contacts[l].b)) < std::min(level(contacts[r].a), level(contacts[r].b));
+	});
+}
+
+// the dynamic body of the contact nearer the ground, or none if both are as high
+// a static one already stays still, and it is shared with the islands solved on other threads, so it must not be written to
+static solver_body *lower_body(std::span<solver_body> bodies, std::span<const std::uint32_t> levels, const contact_constraint &c)
+{
+	auto level = [&](std::uint32_t id) { return is_static(bodies[id]) ? 0 : levels[id]; };
+	solver_body *lower = nullptr;
+	if (level(c.a) < level(c.b))
+		lower = &bodies[c.a];
+	else if (level(c.b) < level(c.a))
+		lower = &bodies[c.b];
+	return lower && !is_static(*lower) ? lower : nullptr;
+}
+
+void propagate_shock(std::span<solver_body> bodies, std::span<const contact_constraint> contacts, std::span<const std::uint32_t> levels,
+	std::span<const std::uint32_t> order, const solver_settings &settings)
+{
+	for (auto i : order)
+	{
+		contact_constraint c = contacts[i];
+		solver_body *lower = lower_body(bodies, levels, c);
+		solver_body held = lower ? *lower : solver_body{};
+		if (lower)
+			lower->inv_m = lower->inv_I = 0;
+
+		compute_masses(bodies[c.a], bodies[c.b], c, settings);
+		solve_contacts(bodies, std::span(&c, 1));
+
+		if (lower)
+			*lower = held;
+	}
+}
+
+void propagate_shock_positions(std::span<glm::vec2> positions, std::span<float> angles, std::span<solver_body> bodies,
+	std::span<const contact_constraint> contacts, std::span<const std::uint32_t> levels, std::span<const std::uint32_t> order)
+{
+	for (auto i : order)
+	{
+		solver_body *lower = lower_body(bodies, levels, contacts[i]);
+		solver_body held = lower ? *lower : solver_body{};
+		if (lower)
+			lower->inv_m = lower->inv_I = 0;
+
+		solve_contact_positions(positions, angles, bodies, contacts.subspan(i, 1));
+
+		if (lower)
+			*lower = held;
+	}
+}
+
+PHYSICS_END
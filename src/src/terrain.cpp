@@ -0,0 +1,122 @@
+#include "terrain.h"
+
+#include <algorithm>
+#include <cmath>
+
+PHYSICS_BEG
+
+// every segment is a view of this one, scaled to the segment's length and rotated onto it
+static const polygon<2> unit_segment = {glm::vec2{0, 0}, {1, 0}};
+
+static shape_view segment_view(glm::vec2 a, glm::vec2 b, length_type index)
+{
+	glm::vec2 ab = b - a;
+	float len = glm::length(ab);
+	shape_view res = len > 0 ? shape_view(unit_segment, a, {len, 1}, ab / len) : shape_view(unit_segment, a, {0, 1}, glm::vec2{1, 0});
+	res.index = index;
+	return res;
+}
+
+// bounds of the segment from a to b and the solid part thickness deep behind it
+static bounding_box solid_bounds(glm::vec2 a, glm::vec2 b, float thickness)
+{
+	bounding_box res{glm::min(a, b), glm::max(a, b)};
+	if (float len = glm::length(b - a); len > 0)
+	{
+		glm::vec2 behind = glm::vec2{b.y - a.y, a.x - b.x} / len * thickness;
+		res = res.merge({glm::min(a, b) + behind, glm::max(a, b) + behind});
+	}
+	return res;
+}
+
+void chain_shape::build()
+{
+	m_tree.clear();
+	for (length_type i = 0; i < segments(); ++i)
+	{
+		glm::vec2 a = m_pts[i];
+		glm::vec2 b = m_pts[(i + 1) % m_pts.size()];
+		m_tree.insert(solid_bounds(a, b, m_thickness), i);
+	}
+}
+
+void chain_shape::query(const bounding_box &box, std::vector<shape_view> &pieces) const
+{
+	m_tree.query(box, [&](std::uint32_t i) { pieces.push_back(piece(i)); });
+}
+
+shape_view chain_shape::piece(length_type i) const
+{
+	return segment_view(m_pts[i], m_pts[(i + 1) % m_pts.size()], i);
+}
+
+glm::vec2 chain_shape::support(glm::vec2 dir) const
+{
+	glm::vec2 res{0, 0};
+	float max = -std::numeric_limits<float>::infinity();
+	for (auto pt : m_pts)
+		if (auto d = glm::dot(pt, dir); d > max)
+		{
+			max = d;
+			res = pt;
+		}
+	return res;
+}
+
+void heightfield_shape::build()
+{
+	if (m_heights.empty())
+	{
+		m_bounds = {{0, 0}, {0, 0}};
+		return;
+	}
+
+	m_bounds = {{0, m_heights[0]}, {0, m_heights[0]}};
+	for (std::size_t i = 0; i + 1 < m_heights.size(); ++i)
+		m_bounds = m_bounds.merge(solid_bounds({m_spacing * i, m_heights[i]}, {m_spacing * (i + 1), m_heights[i + 1]}, m_thickness));
+}
+
+void heightfield_shape::query(const bounding_box &box, std::vector<shape_view> &pieces) const
+{
+	if (m_heights.size() < 2 || !box.overlaps(m_bounds))
+		return;
+
+	// columns under the box, and the ones next to it whose sloped solid part may reach under it
+	auto reach = static_cast<long long>(std::ceil(m_thickness / m_spacing));
+	auto last_column = static_cast<long long>(m_heights.size() - 2);
+	auto first = std::clamp(static_cast<long long>(std::floor(box.min.x / m_spacing)) - reach, 0ll, last_column);
+	auto last = std::clamp(static_cast<long long>(std::floor(box.max.x / m_spacing)) + reach, 0ll, last_column);
+
+	for (auto i = first; i <= last; ++i)
+	{
+		glm::vec2 a{m_spacing * i, m_heights[i]};
+		glm::vec2 b{m_spacing * (i + 1), m_heights[i + 1]};
+		if (!box.overlaps(solid_bounds(a, b, m_thickness)))
+			continue;
+
+		pieces.push_back(piece(static_cast<length_type>(i)));
+	}
+}
+
+shape_view heightfield_shape::piece(length_type i) const
+{
+	return segment_view({m_spacing * i, m_heights[i]}, {m_spacing * (i + 1), m_heights[i + 1]}, i);
+}
+
+glm::vec2 heightfield_shape::support(glm::vec2 dir) const
+{
+	glm::vec2 res{0, 0};
+	float max = -std::numeric_limits<float>::infinity();
+	for (std::size_t i = 0; i < m_heights.size(); ++i)
+	{
+		glm::vec2 pt{m_spacing * i, m_heights[i]};
+		if (auto d = glm::dot(pt, dir); d > max)
+		{
+			max = d;
+			res = pt;
+		}
+	}
+	return res;
+}
+
+PHYSICS_END
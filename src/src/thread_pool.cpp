@@ -0,0 +1,86 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+PHYSICS_BEG
+
+thread_pool::thread_pool(unsigned threads)
+{
+	for (unsigned i = 1; i < threads; ++i)
+		m_workers.emplace_back(&thread_pool::worker, this, i);
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop.store(true, std::memory_order_release);
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+	m_wake.notify_all();
+
+	for (auto &t : m_workers)
+		t.join();
+}
+
+void thread_pool::run(std::size_t count, std::size_t grain, job_fn fn, void *ctx)
+{
+	m_fn = fn;
+	m_ctx = ctx;
+	m_count = count;
+	m_grain = grain;
+	m_chunks = (count + grain - 1) / grain;
+	m_next.store(0, std::memory_order_relaxed);
+	m_done.store(0, std::memory_order_relaxed);
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+	m_wake.notify_all();
+
+	work();
+
+	// every worker takes part in every job, so none can still be reading it when the next one is written
+	while (m_done.load(std::memory_order_acquire) != m_workers.size())
+		std::this_thread::yield();
+}
+
+void thread_pool::work()
+{
+	for (std::size_t i; (i = m_next.fetch_add(1, std::memory_order_relaxed)) < m_chunks;)
+		m_fn(m_ctx, i * m_grain, std::min(m_count, (i + 1) * m_grain));
+}
+
+void thread_pool::worker(unsigned index)
+{
+	constexpr int spin = 4096;
+	m_owner = this;
+	m_index = index;
+
+	for (std::uint64_t seen = 0;;)
+	{
+		std::uint64_t gen = m_generation.load(std::memory_order_acquire);
+		for (int i = 0; gen == seen && i < spin; ++i)
+		{
+			std::this_thread::yield();
+			gen = m_generation.load(std::memory_order_acquire);
+		}
+
+		if (gen == seen)
+		{
+			std::unique_lock lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_generation.load(std::memory_order_acquire) != seen; });
+			gen = m_generation.load(std::memory_order_acquire);
+		}
+
+		seen = gen;
+		if (m_stop.load(std::memory_order_acquire))
+			return;
+
+		work();
+		m_done.fetch_add(1, std::memory_order_release);
+	}
+}
+
+PHYSICS_END
@@ -0,0 +1,233 @@
+#include "tree_solver.h"
+
+PHYSICS_BEG
+
+namespace
+{
+	using sym2 = tree_scratch::sym2;
+	using link = tree_scratch::link;
+	using node = tree_scratch::node;
+
+	sym2 outer(glm::vec2 d, float scale) { return {d.x * d.x * scale, d.x * d.y * scale, d.y * d.y * scale}; }
+
+	// a link held at its length, seen from the body nearer the root
+	// dir points from the other end to the body, rate is the velocity change along it the link needs
+	struct lock
+	{
+		glm::vec2 dir;
+		float rate;
+	};
+
+	constexpr std::uint32_t none = tree_scratch::none;
+}
+
+// velocity change along the link that brings its length rate to what corrects the distance error, dir points from from to to
+static float needed_rate(const link &l, std::uint32_t from, std::uint32_t to, std::span<const solver_body> bodies,
+	std::span<const glm::vec2> positions, float bias_rate, glm::vec2 &dir)
+{
+	glm::vec2 rel_pos = positions[to] - positions[from];
+	float cur_dist = glm::length(rel_pos);
+	dir = rel_pos / cur_dist;
+
+	// the same correction as update_constraints
+	float target = bias_rate * (l.dist - cur_dist);
+	return target - glm::dot(bodies[to].v - bodies[from].v, dir);
+}
+
+bool solve_constraint_tree(std::span<solver_body> bodies, std::span<const glm::vec2> positions, std::span<const std::uint32_t> ids,
+	std::span<std::uint32_t> slots, std::span<const position_constraint> position_constraints,
+	std::span<const rope_constraint> rope_constraints, float bias_rate, tree_scratch &scratch)
+{
+	auto is_static = [&](std::uint32_t id) { return bodies[id].inv_m == 0; };
+
+	auto &[links, nodes, sets, degree, adjacent, fill, order, parent, stack, seen] = scratch;
+	links.clear();
+	auto gather = [&](const auto &constraints, bool rope)
+	{
+		for (const auto &c : constraints)
+		{
+			float cur_dist = glm::length(positions[c.a] - positions[c.b]);
+			if ((rope && cur_dist <= c.dist) || cur_dist == 0 || (is_static(c.a) && is_static(c.b)))
+				continue;
+			links.push_back({c.a, c.b, c.dist});
+		}
+	};
+	gather(position_constraints, false);
+	gather(rope_constraints, true);
+	if (links.empty())
+		return true;
+
+	auto count = static_cast<std::uint32_t>(ids.size());
+	for (std::uint32_t i = 0; i < count; ++i)
+		slots[ids[i]] = i;
+
+	// links between dynamic bodies must not close a loop, a body can be held by at most two static ones
+	nodes.assign(count, node{});
+	sets.reset(count);
+	degree.assign(count + 1, 0);
+	for (std::uint32_t i = 0; i < links.size(); ++i)
+	{
+		const link &l = links[i];
+		if (is_static(l.a) || is_static(l.b))
+		{
+			node &n = nodes[slots[is_static(l.a) ? l.b : l.a]];
+			if (n.anchor_count == 2)
+				return false;
+			n.anchors[n.anchor_count++] = i;
+			continue;
+		}
+
+		std::uint32_t a = slots[l.a], b = slots[l.b];
+		if (sets.find(a) == sets.find(b))
+			return false;
+		sets.unite(a, b);
+		++degree[a + 1];
+		++degree[b + 1];
+	}
+
+	// links by body
+	for (std::uint32_t i = 0; i < count; ++i)
+		degree[i + 1] += degree[i];
+	adjacent.resize(degree[count]);
+	fill.assign(degree.begin(), degree.end() - 1);
+	for (std::uint32_t i = 0; i < links.size(); ++i)
+		if (!is_static(links[i].a) && !is_static(links[i].b))
+		{
+			adjacent[fill[slots[links[i].a]]++] = i;
+			adjacent[fill[slots[links[i].b]]++] = i;
+		}
+
+	// depth first order, so parents come before their children
+	order.clear();
+	parent.assign(count, none);
+	stack.clear();
+	seen.assign(count, false);
+	for (std::uint32_t root = 0; root < count; ++root)
+	{
+		if (seen[root])
+			continue;
+		seen[root] = true;
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			std::uint32_t s = stack.back();
+			stack.pop_back();
+			order.push_back(s);
+			for (auto j = degree[s]; j < degree[s + 1]; ++j)
+			{
+				const link &l = links[adjacent[j]];
+				std::uint32_t other = slots[l.a] == s ? slots[l.b] : slots[l.a];
+				if (seen[other])
+					continue;
+				seen[other] = true;
+				parent[other] = s;
+				nodes[other].parent_link = adjacent[j];
+				stack.push_back(other);
+			}
+		}
+	}
+
+	// leaves up, each body takes in its children as soft links along their direction and its static anchors as locks
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		std::uint32_t s = *it;
+		node &n = nodes[s];
+		std::uint32_t id = ids[s];
+
+		float m = 1 / bodies[id].inv_m;
+		sym2 inertia{m, 0, m};
+		glm::vec2 pull{0, 0};
+		lock locks[2];
+		std::uint32_t lock_count = 0;
+
+		for (auto j = degree[s]; j < degree[s + 1]; ++j)
+		{
+			std::uint32_t child = slots[links[adjacent[j]].a] == s ? slots[links[adjacent[j]].b] : slots[links[adjacent[j]].a];
+			if (parent[child] != s || nodes[child].parent_link != adjacent[j])
+				continue;
+
+			const node &c = nodes[child];
+			glm::vec2 dir;
+			float rate = needed_rate(links[adjacent[j]], ids[child], id, bodies, positions, bias_rate, dir) + glm::dot(c.free_change, dir);
+			float mobility = glm::dot(dir, c.mobility * dir);
+
+			// a child held in place by its own anchors is as good as static along the link
+			if (mobility <= 1e-6f * bodies[ids[child]].inv_m)
+			{
+				if (lock_count == 2)
+					return false;
+				locks[lock_count++] = {dir, rate};
+				continue;
+			}
+			inertia += outer(dir, 1 / mobility);
+			pull += dir * (rate / mobility);
+		}
+		for (std::uint32_t k = 0; k < n.anchor_count; ++k)
+		{
+			const link &l = links[n.anchors[k]];
+			std::uint32_t anchor = l.a == id ? l.b : l.a;
+			if (lock_count == 2)
+				return false;
+			glm::vec2 dir;
+			float rate = needed_rate(l, anchor, id, bodies, positions, bias_rate, dir);
+			locks[lock_count++] = {dir, rate};
+		}
+
+		sym2 inv_inertia = inertia.inverse();
+		if (lock_count == 0)
+		{
+			n.mobility = inv_inertia;
+			n.free_change = inv_inertia * pull;
+		}
+		else if (lock_count == 1)
+		{
+			// moves freely across the lock only
+			glm::vec2 q = inv_inertia * locks[0].dir;
+			float q_dot = glm::dot(locks[0].dir, q);
+			n.mobility = inv_inertia;
+			n.mobility -= outer(q / q_dot, q_dot);
+			n.free_change = n.mobility * pull + q * (locks[0].rate / q_dot);
+		}
+		else
+		{
+			// two locks leave no freedom, unless they are parallel
+			glm::vec2 d1 = locks[0].dir, d2 = locks[1].dir;
+			float det = d1.x * d2.y - d1.y * d2.x;
+			if (std::abs(det) < 1e-4f)
+				return false;
+			n.mobility = {};
+			n.free_change = glm::vec2{d2.y * locks[0].rate - d1.y * locks[1].rate, d1.x * locks[1].rate - d2.x * locks[0].rate} / det;
+		}
+	}
+
+	// roots down, the impulse of each link follows from the velocity change of its parent
+	for (auto s : order)
+	{
+		node &n = nodes[s];
+		if (parent[s] == none)
+		{
+			n.change = n.free_change;
+			continue;
+		}
+
+		std::uint32_t id = ids[s], parent_id = ids[parent[s]];
+		glm::vec2 dir;
+		float rate = needed_rate(links[n.parent_link], id, parent_id, bodies, positions, bias_rate, dir) + glm::dot(n.free_change, dir);
+		float mobility = glm::dot(dir, n.mobility * dir);
+		if (mobility <= 1e-6f * bodies[id].inv_m)
+		{
+			n.change = n.free_change;
+			continue;
+		}
+
+		// the parent gets the impulse along dir, the body the opposite
+		float impulse = (rate - glm::dot(nodes[parent[s]].change, dir)) / mobility;
+		n.change = n.free_change - n.mobility * dir * impulse;
+	}
+
+	for (std::uint32_t s = 0; s < count; ++s)
+		bodies[ids[s]].v += nodes[s].change;
+	return true;
+}
+
+PHYSICS_END
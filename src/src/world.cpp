@@ -1,199 +1,1213 @@
 #include "world.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <tuple>
+#include <utility>
+#include <numeric>
+
 PHYSICS_BEG
 
-void get_dv(const particle &p1, glm::vec2 p1_center,
-			const particle &p2, glm::vec2 p2_center,
-			glm::vec2 collision_pt, glm::vec2 normal, float e,
-			glm::vec2 *dp1v, float *dp1w,
-			glm::vec2 *dp2v, float *dp2w)
-{
-	// https://physics.stackexchange.com/questions/786641/collision-calculation-in-2d
-	// thank you to John Alexiou
-	float x1 = p1_center.x;
-	float y1 = p1_center.y;
-	float x2 = p2_center.x;
-	float y2 = p2_center.y;
-	float xa = collision_pt.x;
-	float ya = collision_pt.y;
-	float vx1 = p1.v.x;
-	float vy1 = p1.v.y;
-	float vx2 = p2.v.x;
-	float vy2 = p2.v.y;
-	float nx = normal.x;
-	float ny = normal.y;
-	float w1 = p1.w;
-	float w2 = p2.w;
-	float m1 = p1.m;
-	float m2 = p2.m;
-	float I1 = p1.I;
-	float I2 = p2.I;
-
-	float v_imp = nx * (vx1 + w1 * (y1 - ya) - vx2 - w2 * (y2 - ya)) +
-				  ny * (vy1 + w1 * (xa - x1) - vy2 - w2 * (xa - x2));
-	
-	float s1 = nx * (y1 - ya) + ny * (xa - x1);
-	float s2 = nx * (y2 - ya) + ny * (xa - x2);
-	float m_imp = 1.f /
-					((1 / m1) + (s1 * s1) / I1 + 1 / m2 + (s2 * s2) / I2);
-	
-	float J = (1 + e) * m_imp * v_imp;
+world::world(float world_width_meters, float world_height_meters, float gravity) : grav{ gravity }, world_width{ world_width_meters }, world_height{ world_height_meters }
+{
+	// walls around the world
+	boundary = std::make_unique<chain_shape>(std::initializer_list<glm::vec2>{{0, 0}, {world_width, 0}, {world_width, world_height}, {0, world_height}}, true);
+	insert_object({{{0, 0}, {0, 0}, {0, 0}, 0, 0, 0, particle::infinity, particle::infinity}, {1, 1}, boundary.get(), {}});
+}
+
+static shape_view view_of(const object &obj, glm::vec2 pos, float angle)
+{
+	return shape_view(*obj.shape, pos, obj.scale, angle);
+}
+
+static shape_view view_of(const object &obj)
+{
+	return view_of(obj, obj.pt.pos, obj.pt.angle);
+}
+
+static bool is_static(const object &obj)
+{
+	return obj.pt.m == particle::infinity;
+}
+
+static bool is_moving(const object &obj)
+{
+	return obj.awake && !is_static(obj);
+}
+
+// bounds of the object now and where it ends up after dt if nothing touches it
+static bounding_box swept_bounds(const object &obj, float dt)
+{
+	bounding_box box = view_of(obj).bounds();
+	if (!is_moving(obj))
+		return box;
+
+	particle pt = obj.pt;
+	pt.update(dt);
+	return box.merge(view_of(obj, pt.pos, pt.angle).bounds());
+}
+
+// farthest any point of the object moves during dt if nothing touches it
+static float sweep_distance(const object &obj, float dt)
+{
+	if (!is_moving(obj))
+		return 0;
+
+	particle pt = obj.pt;
+	pt.update(dt);
+	bounding_box box = view_of(obj).bounds();
+	float reach = glm::length(glm::max(box.max - obj.pt.pos, obj.pt.pos - box.min));
+	return glm::length(pt.pos - obj.pt.pos) + std::abs(pt.angle - obj.pt.angle) * reach;
+}
+
+object *world::insert_object(const object &obj)
+{
+	objects.push_back(obj);
+	auto it = std::prev(objects.end());
+
+	it->id = static_cast<std::uint32_t>(by_id.size());
+	it->proxy = broadphase.insert(view_of(*it).bounds(), it->id);
+	by_id.push_back(it);
+
+	prev_positions.push_back(it->pt.pos);
+	cur_positions.push_back(it->pt.pos);
+	prev_angles.push_back(it->pt.angle);
+	cur_angles.push_back(it->pt.angle);
+
+	return &*it;
+}
+
+object *world::add_object(const abstract_shape &shape, glm::vec2 pos, glm::vec2 v_init, float angle, float w_init, float mass, glm::vec2 scale,
+	collision_filter filter)
+{
+	return insert_object({{pos, v_init, {0, grav}, angle, w_init, 0, mass, mass * 10}, scale, &shape, filter});
+}
+
+object *world::add_static_object(const abstract_shape &shape, glm::vec2 pos, float angle, glm::vec2 scale, collision_filter filter)
+{
+	return insert_object({{pos, {0, 0}, {0, 0}, angle, 0, 0, particle::infinity, particle::infinity}, scale, &shape, filter});
+}
+
+template <typename T>
+constraint_handle world::add_constraint(constraint_bucket<T> &bucket, const T &c)
+{
+	wake(*by_id[c.a]);
+	wake(*by_id[c.b]);
+	constraints_colored[static_cast<std::size_t>(T::kind)] = false;
+	return bucket.add(c);
+}
+
+constraint_handle world::add_position_constraint(object &a, object &b, float distance, float compliance)
+{
+	return add_constraint(position_constraints, {a.id, b.id, distance, compliance});
+}
 
-	if (dp1v)
+constraint_handle world::add_rope_constraint(object &a, object &b, float distance, float compliance)
+{
+	return add_constraint(rope_constraints, {a.id, b.id, distance, compliance});
+}
+
+// the point in the unrotated frame of the object
+static glm::vec2 local_point(const object &obj, glm::vec2 point)
+{
+	return rotate(point - obj.pt.pos, -obj.pt.angle);
+}
+
+constraint_handle world::add_revolute_joint(object &a, object &b, glm::vec2 anchor)
+{
+	return add_constraint(revolute_joints, {a.id, b.id, local_point(a, anchor), local_point(b, anchor), b.pt.angle - a.pt.angle});
+}
+
+constraint_handle world::add_prismatic_joint(object &a, object &b, glm::vec2 anchor, glm::vec2 axis)
+{
+	return add_constraint(prismatic_joints, {a.id, b.id, local_point(a, anchor), local_point(b, anchor), rotate(glm::normalize(axis), -a.pt.angle),
+		b.pt.angle - a.pt.angle});
+}
+
+constraint_handle world::add_weld_joint(object &a, object &b, glm::vec2 anchor)
+{
+	return add_constraint(weld_joints, {a.id, b.id, local_point(a, anchor), local_point(b, anchor), b.pt.angle - a.pt.angle});
+}
+
+constraint_handle world::add_motor_joint(object &a, object &b, float max_force, float max_torque)
+{
+	return add_constraint(motor_joints, {a.id, b.id, local_point(a, b.pt.pos), b.pt.angle - a.pt.angle, max_force, max_torque});
+}
+
+bool world::remove_constraint(constraint_handle h)
+{
+	bool removed = false;
+	for_each_bucket([&](auto &bucket)
 	{
-		float dvx1 = -nx / m1 * J;
-		float dvy1 = -ny / m1 * J;
+		if (!bucket.contains(h))
+			return;
+
+		// what it held together may fall apart now
+		wake(*by_id[bucket[h].a]);
+		wake(*by_id[bucket[h].b]);
+		bucket.remove(h);
+		removed = true;
+	});
+	return removed;
+}
+
+void world::wake(object &obj)
+{
+	if (obj.awake)
+		return;
 
-		dp1v->x += dvx1;
-		dp1v->y += dvy1;
+	std::uint32_t index = obj.sleep_group;
+	auto &group = sleep_groups[index];
+	for (auto id : group)
+	{
+		object &o = *by_id[id];
+		o.awake = true;
+		o.sleep_time = 0;
+		o.sleep_group = no_island;
 	}
+	sleeping_count -= group.size();
+
+	free_sleep_groups.push_back(index);
+	group.clear();
+}
 
-	if (dp1w)
+void world::set_transform(object &obj, glm::vec2 pos, float angle)
+{
+	wake(obj);
+	obj.pt.pos = pos;
+	obj.pt.angle = angle;
+	prev_positions[obj.id] = cur_positions[obj.id] = pos;
+	prev_angles[obj.id] = cur_angles[obj.id] = angle;
+}
+
+void world::sleep(std::span<const std::uint32_t> ids)
+{
+	std::uint32_t group;
+	if (free_sleep_groups.empty())
 	{
-		float dw1 = -s1 / I1 * J;
+		group = static_cast<std::uint32_t>(sleep_groups.size());
+		sleep_groups.emplace_back();
+	}
+	else
+	{
+		group = free_sleep_groups.back();
+		free_sleep_groups.pop_back();
+	}
 
-		*dp1w += dw1;
+	sleep_groups[group].assign(ids.begin(), ids.end());
+	for (auto id : ids)
+	{
+		object &o = *by_id[id];
+		o.awake = false;
+		o.pt.v = {0, 0};
+		o.pt.w = 0;
+		o.sleep_group = group;
 	}
+	sleeping_count += ids.size();
+}
+
+// returns whether the object has been slow for long enough to sleep
+bool world::update_sleep_time(object &obj) const
+{
+	float lin = solver.sleep_linear_velocity, ang = solver.sleep_angular_velocity;
+	if (glm::dot(obj.pt.v, obj.pt.v) > lin * lin || std::abs(obj.pt.w) > ang)
+		obj.sleep_time = 0;
+	else
+		obj.sleep_time += step_length();
+
+	return obj.sleep_time >= solver.time_to_sleep;
+}
 
-	if (dp2v)
+void world::update_sleeping()
+{
+	if (!solver.sleeping)
 	{
-		float dvx2 = nx / m2 * J;
-		float dvy2 = ny / m2 * J;
-			
-		dp2v->x += dvx2;
-		dp2v->y += dvy2;
+		for (auto &group : sleep_groups)
+			if (!group.empty())
+				wake(*by_id[group.front()]);
+		return;
 	}
 
-	if (dp2w)
+	for (const auto &isl : islands)
+		if (isl.sleepy)
+			sleep(std::span(island_bodies).subspan(isl.bodies.begin, isl.bodies.end - isl.bodies.begin));
+
+	for (auto id : loose_bodies)
+		if (update_sleep_time(*by_id[id]))
+			sleep(std::span(&id, 1));
+}
+
+void world::update(float dt)
+{
+	counters = {};
+	events.clear();
+	contacts.clear();
+
+	float step = step_length();
+	accumulator += dt;
+	int steps = static_cast<int>(accumulator / step);
+	if (solver.max_steps > 0 && steps > solver.max_steps)
+	{
+		steps = solver.max_steps;
+		accumulator = std::fmod(accumulator, step);
+	}
+	else
+		accumulator = std::max(accumulator - steps * step, 0.f);
+
+	// only the last step is interpolated over, the earlier ones are whole steps behind the time of the update
+	for (int i = 0; i < steps; ++i)
 	{
-		float dw2 = s2 / I2 * J;
-		*dp2w += dw2;
+		if (i == steps - 1)
+			store_transforms(prev_positions, prev_angles);
+		update_internal();
 	}
+	if (steps > 0)
+		store_transforms(cur_positions, cur_angles);
 }
 
-void resolve_velocities(particle &p1, glm::vec2 p1_center, particle &p2, glm::vec2 p2_center, const collision &coll, float e)
+void world::store_transforms(std::vector<glm::vec2> &to_positions, std::vector<float> &to_angles) const
 {
-	glm::vec2 dp1v(0, 0);
-	glm::vec2 dp2v(0, 0);
-	float dp1w = 0.f;
-	float dp2w = 0.f;
-	
-	// if (collision_pt.size() == 1)
-	// {
-	// 	get_dv(p1, p1_center, p2, p2_center, *collision_pt.pts[0], coll.normal, e, &dp1v, &dp1w, &dp2v, &dp2w);
-	// }
-	// else if (collision_pt.size() == 2)
-	// {
-		// get the change in angular velocity without the change in linear velocity
-		// get_dv(p1, p1_center, p2, p2_center, coll.a_contact, coll.normal, e, nullptr, &dp1w, nullptr, &dp2w);
-		// get_dv(p1, p1_center, p2, p2_center, coll.b_contact, coll.normal, e, nullptr, &dp1w, nullptr, &dp2w);
-
-		// get the change in linear velocity without the change in angular velocity
-		// glm::vec2 average = (coll.a_contact + coll.b_contact) / 2.f;
-		// get_dv(p1, p1_center, p2, p2_center, average, coll.normal, e, &dp1v, nullptr, &dp2v, nullptr);
-	// }
-	// else
-	// 	return;
-
-	p1.v += dp1v;
-	p2.v += dp2v;
-
-	p1.w += dp1w;
-	p2.w += dp2w;
+	for (const auto &obj : objects)
+	{
+		to_positions[obj.id] = obj.pt.pos;
+		to_angles[obj.id] = obj.pt.angle;
+	}
 }
 
-world::world(float world_width_meters, float world_height_meters, float gravity) : grav{ gravity }, world_width{ world_width_meters }, world_height{ world_height_meters }
+void world::update_internal()
 {
-	static polygon<4> rect = {glm::vec2{0, 0}, {1, 0}, {1, 1}, {0, 1}};
-	
-	constexpr float bound_width = 10'000'000.f;
-	// bottom wall
-	objects.push_back({{{-bound_width, -bound_width}, {0, 0}, {0, 0}, 0, 0, 0, particle::infinity, particle::infinity}, {bound_width * 2 + world_width, bound_width}, &rect});
-	// left wall
-	objects.push_back({{{-bound_width, 0}, {0, 0}, {0, 0}, 0, 0, 0, particle::infinity, particle::infinity}, {bound_width, world_height}, &rect});
-	// right wall
-	objects.push_back({{{world_width, 0}, {0, 0}, {0, 0}, 0, 0, 0, particle::infinity, particle::infinity}, {bound_width, world_height}, &rect});
-	// top wall
-	objects.push_back({{{-bound_width, world_height}, {0, 0}, {0, 0}, 0, 0, 0, particle::infinity, particle::infinity}, {bound_width * 2 + world_width, bound_width}, &rect});
+	++counters.steps;
+
+	// xpbd integrates during its substeps, the other modes move the objects once their velocities are solved
+	if (solver.mode != solver_mode::xpbd)
+		for (auto &obj : objects)
+			if (obj.awake)
+				obj.pt.update_velocity(solver.time_step);
+
+	update_pool();
+
+	resolve_bounds();
+	update_sensors();
+
+	build_islands();
+	solve_islands();
+	update_sleeping();
+	update_contacts();
+
+	island_counters.sleeping = sleeping_count;
+}
+
+// finds the pairs whose fattened bounds overlap and that pass their collision filters
+// pairs are ordered like the objects, so they are resolved in the same order as before
+void world::update_broadphase()
+{
+	pairs.clear();
+	sensor_pairs.clear();
+	order.resize(by_id.size());
+
+	// xpbd finds its contacts during the step, so the bounds cover all of it
+	bool xpbd = solver.mode == solver_mode::xpbd;
+
+	std::uint32_t i = 0;
+	for (auto &obj : objects)
+	{
+		// sleeping objects keep their bounds
+		if (obj.awake)
+			broadphase.move(obj.proxy, xpbd ? swept_bounds(obj, solver.xpbd_step) : view_of(obj).bounds());
+		order[obj.id] = i++;
+	}
+
+	// only moving objects and sensors search the tree, the others are found by them
+	auto searches = [](const object &obj) { return obj.sensor || is_moving(obj); };
+
+	for (auto it = objects.begin(); it != objects.end(); ++it)
+	{
+		if (!searches(*it))
+			continue;
+
+		broadphase.query(broadphase.bounds(it->proxy), [&](std::uint32_t id)
+		{
+			auto other = by_id[id];
+			if (other == it || (searches(*other) && order[id] < order[it->id]))
+				return;
+
+			auto a = it, b = other;
+			if (order[b->id] < order[a->id])
+				std::swap(a, b);
+
+			// neither can move
+			if (is_static(*a) && is_static(*b))
+				return;
+
+			// a sleeping pile only wakes when something moving touches it
+			if (!is_moving(*a) && !is_moving(*b) && !a->sensor && !b->sensor)
+				return;
+
+			// sensors don't detect each other
+			if (a->sensor && b->sensor)
+				return;
+
+			++counters.broadphase_pairs;
+			if (!a->filter.collides(b->filter))
+			{
+				++counters.filtered_pairs;
+				return;
+			}
+
+			if (a->sensor)
+				sensor_pairs.push_back({a, b});
+			else if (b->sensor)
+				sensor_pairs.push_back({b, a});
+			else
+				pairs.push_back({a, b});
+		});
+	}
+
+	std::sort(pairs.begin(), pairs.end(), [&](const object_pair &l, const object_pair &r)
+	{
+		return order[l.first->id] != order[r.first->id] ? order[l.first->id] < order[r.first->id] : order[l.second->id] < order[r.second->id];
+	});
 }
 
-template <typename object>
-bool object_compare(const object &a, const object &b)
+void world::update_pool()
 {
-	return a.pt.pos.y > b.pt.pos.y;
+	if (solver.threads <= 1)
+		pool.reset();
+	else if (!pool || pool->size() != solver.threads)
+		pool = std::make_unique<thread_pool>(solver.threads);
+	scratch.resize(pool ? pool->size() : 1);
 }
 
-object *world::add_object(const abstract_shape &shape, glm::vec2 pos, glm::vec2 v_init, float angle, float w_init, float mass, glm::vec2 scale)
+// merges the dynamic objects along contacts and constraints, then sorts the contacts and constraints by island and color
+// islands are numbered in object order and keep the order of their items, so the result doesn't depend on the threads
+void world::build_islands()
 {
-	objects.push_back({{pos, v_init, {0, grav}, angle, w_init, 0, mass, mass * 10}, scale, &shape});
-	auto res = &objects.back();
-	objects.sort(object_compare<object>); // temporary solution
+	island_sets.reset(by_id.size());
+	island_of.assign(by_id.size(), no_island);
+	bodies.resize(by_id.size());
+	positions.resize(by_id.size());
+	angles.resize(by_id.size());
+	if (solver.mode == solver_mode::xpbd)
+		xpbd_bodies.resize(by_id.size());
+	island_slots.resize(by_id.size());
 
-	return res;
+	// constraints pulling on a sleeping object from a moving one wake it, those between objects that don't move are skipped
+	for_each_bucket([&](auto &bucket)
+	{
+		for (const auto &c : bucket.items())
+		{
+			object &a = *by_id[c.a];
+			object &b = *by_id[c.b];
+			if (is_moving(a) || is_moving(b))
+			{
+				wake(a);
+				wake(b);
+			}
+		}
+	});
+
+	// marks the objects that are part of an island, unconnected ones only move by their own velocity
+	auto connect = [&](const object &a, const object &b)
+	{
+		if (!is_moving(a) && !is_moving(b))
+			return;
+
+		bool a_static = is_static(a), b_static = is_static(b);
+		if (!a_static)
+			island_of[a.id] = 0;
+		if (!b_static)
+			island_of[b.id] = 0;
+		if (!a_static && !b_static)
+			island_sets.unite(a.id, b.id);
+	};
+	for (const auto &c : collisions)
+		connect(*c.a, *c.b);
+	for_each_bucket([&](auto &bucket)
+	{
+		for (const auto &c : bucket.items())
+			connect(*by_id[c.a], *by_id[c.b]);
+	});
+
+	islands.clear();
+	loose_bodies.clear();
+	root_island.assign(by_id.size(), no_island);
+	for (const auto &obj : objects)
+	{
+		if (is_static(obj))
+		{
+			bodies[obj.id] = {obj.pt.v, obj.pt.w, 0, 0};
+			positions[obj.id] = obj.pt.pos;
+			angles[obj.id] = obj.pt.angle;
+			if (solver.mode == solver_mode::xpbd)
+				xpbd_bodies[obj.id] = {obj.pt.pos, obj.pt.pos, obj.pt.angle, obj.pt.angle, obj.pt.v, obj.pt.w, {0, 0}, 0, 0, 0};
+			continue;
+		}
+		if (!obj.awake)
+			continue;
+		if (island_of[obj.id] == no_island)
+		{
+			loose_bodies.push_back(obj.id);
+			continue;
+		}
+
+		std::uint32_t root = island_sets.find(obj.id);
+		if (root_island[root] == no_island)
+		{
+			root_island[root] = static_cast<std::uint32_t>(islands.size());
+			islands.emplace_back();
+		}
+		island_of[obj.id] = root_island[root];
+		++islands[root_island[root]].bodies.end;
+	}
+
+	// body ranges from the counts, then the ids in object order
+	std::uint32_t body_count = 0;
+	for (auto &isl : islands)
+	{
+		std::uint32_t count = isl.bodies.end;
+		isl.bodies = {body_count, body_count};
+		body_count += count;
+	}
+	island_bodies.resize(body_count);
+	for (const auto &obj : objects)
+		if (!is_static(obj) && island_of[obj.id] != no_island)
+			island_bodies[islands[island_of[obj.id]].bodies.end++] = obj.id;
+
+	coloring.reset(by_id.size());
+	for (auto &c : collisions)
+	{
+		c.island = island_of[is_static(*c.a) ? c.b->id : c.a->id];
+		c.color = coloring.add(c.a->id, c.b->id, is_static(*c.a), is_static(*c.b));
+	}
+	std::stable_sort(collisions.begin(), collisions.end(), [](const collision_pair &l, const collision_pair &r)
+	{
+		return l.island != r.island ? l.island < r.island : l.color < r.color;
+	});
+	group_by_island(collisions.size(), [&](std::uint32_t i) { return std::pair(collisions[i].island, collisions[i].color); }, contact_colors,
+		[](island &isl) { return std::tie(isl.contacts, isl.contact_colors); });
+
+	for_each_bucket([&](auto &bucket) { sort_constraints(bucket); });
+
+	small_islands.clear();
+	large_islands.clear();
+	island_counters = {};
+	island_counters.count = islands.size();
+	for (std::uint32_t i = 0; i < islands.size(); ++i)
+	{
+		auto &isl = islands[i];
+		std::size_t size = isl.bodies.end - isl.bodies.begin;
+		std::size_t work = isl.contacts.end - isl.contacts.begin;
+		for (auto range : isl.constraints)
+			work += range.end - range.begin;
+
+		isl.split = pool && work > large_island;
+		(isl.split ? large_islands : small_islands).push_back(i);
+		island_counters.split += isl.split;
+
+		island_counters.largest = std::max(island_counters.largest, size);
+		++island_counters.sizes[std::min<std::size_t>(std::bit_width(size) - 1, island_counters.sizes.size() - 1)];
+	}
 }
 
-object *world::add_static_object(const abstract_shape &shape, glm::vec2 pos, float angle, glm::vec2 scale)
+// splits items sorted by island and color into ranges of one color, and sets each island's ranges of items and colors
+// key_at(i) gives the island and color of item i, ranges_of(island) ties the island's item and color ranges
+template <typename KeyAt, typename RangesOf>
+void world::group_by_island(std::size_t count, KeyAt key_at, std::vector<color_range> &ranges, RangesOf ranges_of)
 {
-	objects.push_back({{pos, {0, 0}, {0, 0}, angle, 0, 0, particle::infinity, particle::infinity}, scale, &shape});
-	auto res = &objects.back();
-	objects.sort(object_compare<object>); // temporary solution
+	ranges.clear();
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		auto [isl, color] = key_at(i);
+		if (isl == no_island)
+			break;
 
-	return res;
+		auto [items, colors] = ranges_of(islands[isl]);
+		bool new_island = i == 0 || isl != key_at(i - 1).first;
+		if (new_island)
+		{
+			items = {i, i};
+			colors = {static_cast<std::uint32_t>(ranges.size()), static_cast<std::uint32_t>(ranges.size())};
+		}
+		if (new_island || color != key_at(i - 1).second)
+		{
+			ranges.push_back({i, i, color == graph_coloring::overflow_color});
+			++colors.end;
+		}
+		ranges.back().end = i + 1;
+		items.end = i + 1;
+	}
 }
 
-void world::update_internal()
+// colors the bucket if it changed, then moves its constraints into island and color order
+template <typename T>
+void world::sort_constraints(constraint_bucket<T> &bucket)
 {
-	for (auto &obj : objects)
-		obj.pt.update(time_step);
+	constexpr auto kind = static_cast<std::size_t>(T::kind);
+	auto items = bucket.items();
 
-	resolve_bounds();
+	// removing a constraint leaves the colors of the others valid, only adding one needs new colors
+	if (!constraints_colored[kind])
+	{
+		coloring.reset(by_id.size());
+		for (auto &c : items)
+			c.color = coloring.add(c.a, c.b, is_static(*by_id[c.a]), is_static(*by_id[c.b]));
+		constraints_colored[kind] = true;
+	}
 
-	for (const auto &c : constraints)
-		c->update(time_step);
-	
-	for (const auto &[a, b, coll] : collisions)
+	// constraints between objects that don't move belong to no island and are not updated
+	constraint_keys.resize(items.size());
+	for (std::uint32_t i = 0; i < items.size(); ++i)
 	{
-		glm::vec2 a_center = a->shape->center() * a->scale + a->pt.pos;
-		glm::vec2 b_center = b->shape->center() * b->scale + b->pt.pos;
+		const object &a = *by_id[items[i].a];
+		const object &b = *by_id[items[i].b];
+		std::uint32_t isl = !is_moving(a) && !is_moving(b) ? no_island : island_of[is_static(a) ? b.id : a.id];
+		constraint_keys[i] = std::uint64_t{isl} << 32 | items[i].color;
+	}
 
-		resolve_velocities(a->pt, a_center, b->pt, b_center, coll, .85f);
+	// islands rarely change, so the order is usually kept from the last step
+	if (!std::is_sorted(constraint_keys.begin(), constraint_keys.end()))
+	{
+		constraint_order.resize(items.size());
+		std::iota(constraint_order.begin(), constraint_order.end(), 0);
+		std::stable_sort(constraint_order.begin(), constraint_order.end(), [&](std::uint32_t l, std::uint32_t r)
+		{
+			return constraint_keys[l] < constraint_keys[r];
+		});
+		bucket.permute(constraint_order);
+		std::sort(constraint_keys.begin(), constraint_keys.end());
 	}
+
+	group_by_island(items.size(), [&](std::uint32_t i)
+	{
+		return std::pair(static_cast<std::uint32_t>(constraint_keys[i] >> 32), static_cast<std::uint32_t>(constraint_keys[i]));
+	}, constraint_colors[kind], [](island &isl) { return std::tie(isl.constraints[kind], isl.constraint_colors[kind]); });
 }
 
+// calls f(begin, end) on the items of each color in order, spreading the parallel colors of split islands over the pool
+template <typename F>
+void world::for_each_color(const island &isl, index_range colors, const std::vector<color_range> &ranges, F &&f)
+{
+	for (auto i = colors.begin; i < colors.end; ++i)
+	{
+		auto [begin, end, serial] = ranges[i];
+		if (serial || !isl.split)
+			f(begin, end);
+		else
+			pool->parallel_for(end - begin, parallel_grain, [&](std::size_t first, std::size_t last)
+			{
+				f(static_cast<std::uint32_t>(begin + first), static_cast<std::uint32_t>(begin + last));
+			});
+	}
+}
+
+// calls f(begin, end) on chunks of independent items, on the pool if the island is split
+template <typename F>
+void world::for_each_chunk(const island &isl, index_range items, F &&f)
+{
+	if (!isl.split)
+		return f(items.begin, items.end);
+
+	pool->parallel_for(items.end - items.begin, parallel_grain, [&](std::size_t first, std::size_t last)
+	{
+		f(static_cast<std::uint32_t>(items.begin + first), static_cast<std::uint32_t>(items.begin + last));
+	});
+}
+
+// atomic maximum, for results gathered from several threads
+static void raise_to(std::atomic<float> &max, float x)
+{
+	float current = max.load(std::memory_order_relaxed);
+	while (x > current && !max.compare_exchange_weak(current, x, std::memory_order_relaxed))
+		;
+}
+
+static std::uint64_t pair_key(std::uint32_t a, std::uint32_t b)
+{
+	return std::uint64_t{std::min(a, b)} << 32 | std::max(a, b);
+}
+
+// the pieces of a manifold between a and b, in the order of pair_key
+static std::uint64_t pieces_key(std::uint32_t a, std::uint32_t b, const collision &coll)
+{
+	return a < b ? std::uint64_t{coll.piece_a} << 32 | coll.piece_b : std::uint64_t{coll.piece_b} << 32 | coll.piece_a;
+}
+
+// small islands are independent tasks on the pool, large ones are solved one after another with their colors split over it
+void world::solve_islands()
+{
+	bool xpbd = solver.mode == solver_mode::xpbd;
+	auto solve = [&](island &isl) { xpbd ? solve_island_xpbd(isl) : solve_island(isl); };
+	if (xpbd)
+		xpbd_contacts.resize(collisions.size());
+	else
+		contact_constraints.resize(collisions.size());
+
+	if (pool)
+		pool->parallel_for(small_islands.size(), 1, [&](std::size_t begin, std::size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+				solve(islands[small_islands[i]]);
+		});
+	else
+		for (auto i : small_islands)
+			solve(islands[i]);
+
+	for (auto i : large_islands)
+		solve(islands[i]);
+
+	solves.clear();
+	if (!xpbd)
+	{
+		for (const auto &isl : islands)
+		{
+			solves.push_back({isl.bodies.end - isl.bodies.begin, isl.iterations, isl.residual});
+			island_counters.iterations += isl.iterations;
+			island_counters.most_iterations = std::max<std::size_t>(island_counters.most_iterations, isl.iterations);
+			island_counters.residual = std::max(island_counters.residual, isl.residual);
+		}
+		counters.velocity_iterations += island_counters.iterations;
+		int budget = solver.mode == solver_mode::global ? solver.global_iterations : solver.velocity_iterations;
+		counters.skipped_iterations += islands.size() * std::max(budget, 0) - island_counters.iterations;
+		counters.residual = std::max(counters.residual, island_counters.residual);
+
+		// static and loose objects, the islands move their own
+		for (auto &obj : objects)
+			if (obj.awake && island_of[obj.id] == no_island)
+				obj.pt.update_position(solver.time_step);
+		return update_impulse_cache();
+	}
+
+	// nothing to warm start from if the mode changes back
+	impulse_cache.clear();
+	for (auto id : loose_bodies)
+		by_id[id]->pt.update(solver.xpbd_step);
+
+	// pairs that never touched during the substeps are no contacts
+	std::erase_if(collisions, [](const collision_pair &c) { return c.coll.point_count == 0; });
+	counters.collisions += collisions.size();
+}
+
+// steps the constraints one type after another, then sequential impulses on the contacts warm started from the impulses of the last step
+// the global mode solves the constraints, joints and contacts together instead, serially even for split islands
+void world::solve_island(island &isl)
+{
+	bool global = solver.mode == solver_mode::global;
+
+	for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const object &obj = *by_id[island_bodies[i]];
+			bodies[obj.id] = {obj.pt.v, obj.pt.w, 1 / obj.pt.m, 1 / obj.pt.I};
+			positions[obj.id] = obj.pt.pos;
+			angles[obj.id] = obj.pt.angle;
+		}
+	});
+
+	auto island_ids = std::span(island_bodies).subspan(isl.bodies.begin, isl.bodies.end - isl.bodies.begin);
+	auto &own_scratch = scratch[pool ? pool->thread_index() : 0];
+	auto constraints = [&](auto &bucket, constraint_kind kind)
+	{
+		auto [begin, end] = isl.constraints[static_cast<std::size_t>(kind)];
+		return bucket.items().subspan(begin, end - begin);
+	};
+	auto island_positions = constraints(std::as_const(position_constraints), constraint_kind::position);
+	auto island_ropes = constraints(std::as_const(rope_constraints), constraint_kind::rope);
+	float bias_rate = make_softness(solver.joint_hertz, solver.joint_damping_ratio, solver.time_step).bias_rate;
+
+	bool direct = !global && solver.direct_trees
+		&& solve_constraint_tree(bodies, positions, island_ids, island_slots, island_positions, island_ropes, bias_rate, own_scratch.tree);
+	if (!global && !direct)
+		for_each_distance_bucket([&](auto &bucket)
+		{
+			using T = typename std::remove_reference_t<decltype(bucket)>::value_type;
+			constexpr auto kind = static_cast<std::size_t>(T::kind);
+
+			auto items = std::as_const(bucket).items();
+			for_each_color(isl, isl.constraint_colors[kind], constraint_colors[kind], [&](std::uint32_t begin, std::uint32_t end)
+			{
+				// the overflow color can share bodies
+				if (solver.simd && items[begin].color != graph_coloring::overflow_color)
+					update_constraints_wide(bodies, positions, items.subspan(begin, end - begin), bias_rate);
+				else
+					update_constraints(bodies, positions, items.subspan(begin, end - begin), bias_rate);
+			});
+		});
+
+	for_each_chunk(isl, isl.contacts, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto &[a, b, coll, impulse, in_island, color] = collisions[i];
+			auto &c = contact_constraints[i];
+			c.a = a->id;
+			c.b = b->id;
+			c.normal = coll.normal;
+			c.friction = std::sqrt(a->friction * b->friction);
+			c.restitution = std::max(a->restitution, b->restitution);
+			c.point_count = coll.point_count;
+
+			// composites touching in several places have a manifold for each pair of pieces
+			auto key = std::pair(pair_key(a->id, b->id), pieces_key(a->id, b->id, coll));
+			auto cached = std::lower_bound(impulse_cache.begin(), impulse_cache.end(), key,
+				[](const cached_impulse &e, const auto &k) { return std::pair(e.key, e.pieces) < k; });
+			bool warm = solver.warm_starting && cached != impulse_cache.end() && std::pair(cached->key, cached->pieces) == key;
+
+			for (std::uint32_t p = 0; p < c.point_count; ++p)
+			{
+				c.points[p].ra = coll.points[p] - a->pt.pos;
+				c.points[p].rb = coll.points[p] - b->pt.pos;
+				// the clipped depths can overshoot the penetration when the normal is poorly defined, like for shapes that barely touch
+				float depth = std::min(coll.depths[p], coll.dist);
+				c.points[p].separation = -depth;
+				c.points[p].local_a = rotate(coll.points[p] + coll.normal * (depth / 2) - a->pt.pos, -a->pt.angle);
+				c.points[p].local_b = rotate(coll.points[p] - coll.normal * (depth / 2) - b->pt.pos, -b->pt.angle);
+				c.points[p].normal_impulse = warm ? cached->normal[p] : 0;
+				c.points[p].tangent_impulse = warm ? cached->tangent[p] : 0;
+			}
+		}
+	});
+
+	std::span<contact_constraint> all(contact_constraints);
+	auto range = [&](std::uint32_t begin, std::uint32_t end) { return all.subspan(begin, end - begin); };
+	auto island_contacts = range(isl.contacts.begin, isl.contacts.end);
+
+	// restitution is measured on the velocities before any warm start
+	for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		prepare_contacts(bodies, range(begin, end), solver.time_step, solver);
+	});
+	if (solver.warm_starting && !global)
+		for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+		{
+			warm_start_contacts(bodies, range(begin, end));
+		});
+
+	// calls f on the joints of each color, one type after another
+	auto joint_colors = [&](auto &&f)
+	{
+		for_each_joint_bucket([&](auto &bucket)
+		{
+			using T = typename std::remove_reference_t<decltype(bucket)>::value_type;
+			constexpr auto kind = static_cast<std::size_t>(T::kind);
+
+			auto items = bucket.items();
+			for_each_color(isl, isl.constraint_colors[kind], constraint_colors[kind], [&](std::uint32_t begin, std::uint32_t end)
+			{
+				f(items.subspan(begin, end - begin));
+			});
+		});
+	};
+	joint_colors([&](auto joints)
+	{
+		prepare_joints(bodies, positions, angles, joints, solver.time_step, solver);
+		if (solver.warm_starting && !global)
+			warm_start_joints(bodies, std::span<const typename decltype(joints)::element_type>(joints));
+	});
+	// colors of split islands are solved on several threads, each raises the residual of the iteration
+	std::atomic<float> residual{0};
+	auto solve_all_joints = [&]
+	{
+		joint_colors([&](auto joints) { raise_to(residual, solve_joints(bodies, joints, solver.time_step)); });
+	};
+	auto converged = [&]
+	{
+		++isl.iterations;
+		isl.residual = residual.exchange(0);
+		return isl.residual < solver.residual_tolerance;
+	};
+
+	isl.iterations = 0;
+	isl.residual = 0;
+	if (global)
+	{
+		island_joints joints{constraints(revolute_joints, constraint_kind::revolute), constraints(prismatic_joints, constraint_kind::prismatic),
+			constraints(weld_joints, constraint_kind::weld), constraints(motor_joints, constraint_kind::motor)};
+		auto solved = solve_global(bodies, positions, island_ids, island_slots, island_contacts, island_positions, island_ropes, joints,
+			bias_rate, solver.time_step, solver.global_iterations, solver.residual_tolerance, own_scratch.global);
+		isl.iterations = solved.iterations;
+		isl.residual = solved.residual;
+	}
+	else
+		for (int i = 0; i < solver.velocity_iterations; ++i)
+		{
+			solve_all_joints();
+			for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+			{
+				raise_to(residual, solve_contacts(bodies, range(begin, end)));
+			});
+			if (converged())
+				break;
+		}
+
+	// the contacts of the island in one serial pass from the ground up, levels reuse the island slots
+	const auto &shock_order = own_scratch.levels.order;
+	if (solver.shock_propagation)
+	{
+		order_by_level(bodies, island_contacts, island_slots, own_scratch.levels);
+		propagate_shock(bodies, island_contacts, island_slots, shock_order, solver);
+	}
+
+	for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			std::uint32_t id = island_bodies[i];
+			positions[id] += bodies[id].v * solver.time_step;
+			angles[id] += bodies[id].w * solver.time_step;
+		}
+	});
+	// the pushes have moved the bodies apart, their speed is taken out again
+	if (solver.position_iterations == 0)
+		for (int i = 0; i < solver.velocity_iterations; ++i)
+			for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+			{
+				relax_contacts(bodies, range(begin, end), solver);
+			});
+
+	// the overlaps are resolved once the velocities are final, all pairs at once instead of one after another
+	for (int i = 0; i < solver.position_iterations; ++i)
+		for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+		{
+			solve_contact_positions(positions, angles, bodies, range(begin, end));
+		});
+	if (solver.shock_propagation)
+		propagate_shock_positions(positions, angles, bodies, island_contacts, island_slots, shock_order);
+
+	for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			object &obj = *by_id[island_bodies[i]];
+			obj.pt.v = bodies[obj.id].v;
+			obj.pt.w = bodies[obj.id].w;
+			obj.pt.pos = positions[obj.id];
+			obj.pt.angle = angles[obj.id];
+		}
+	});
+
+	// the island only sleeps as a whole, so every timer keeps counting
+	isl.sleepy = solver.sleeping;
+	if (solver.sleeping)
+		for (auto i = isl.bodies.begin; i < isl.bodies.end; ++i)
+			isl.sleepy &= update_sleep_time(*by_id[island_bodies[i]]);
+}
+
+// substeps of integrating, moving the objects out of the constraints and contacts and taking the velocities from the moves
+// the contacts are found again on every substep, among the pairs whose bounds meet during the step
+void world::solve_island_xpbd(island &isl)
+{
+	float h = solver.xpbd_step / static_cast<float>(std::max(solver.substeps, 1));
+	auto ids = [&](std::uint32_t begin, std::uint32_t end) { return std::span(island_bodies).subspan(begin, end - begin); };
+
+	for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto id : ids(begin, end))
+		{
+			const particle &pt = by_id[id]->pt;
+			xpbd_bodies[id] = {pt.pos, pt.pos, pt.angle, pt.angle, pt.v, pt.w, pt.a, pt.alpha, 1 / pt.m, 1 / pt.I};
+		}
+	});
+
+	for_each_chunk(isl, isl.contacts, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto &[a, b, coll, impulse, in_island, color] = collisions[i];
+			auto &c = xpbd_contacts[i];
+			c.a = a->id;
+			c.b = b->id;
+			c.friction = std::sqrt(a->friction * b->friction);
+			c.restitution = std::max(a->restitution, b->restitution);
+			c.impulse = 0;
+		}
+	});
+
+	// collides the pair where the substep moved them, the manifold points are halfway between the surfaces
+	auto collide = [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			auto &pair = collisions[i];
+			auto &c = xpbd_contacts[i];
+			const xpbd_body &a = xpbd_bodies[c.a];
+			const xpbd_body &b = xpbd_bodies[c.b];
+
+			c.point_count = 0;
+			auto res = collides(view_of(*pair.a, a.pos, a.angle), view_of(*pair.b, b.pos, b.angle), piece_pair{pair.coll.piece_a, pair.coll.piece_b});
+			if (!res)
+				continue;
+
+			c.normal = res.normal;
+			c.point_count = res.point_count;
+			for (std::uint32_t p = 0; p < c.point_count; ++p)
+			{
+				glm::vec2 half_depth = res.normal * (res.depths[p] / 2);
+				c.local_a[p] = rotate(res.points[p] + half_depth - a.pos, -a.angle);
+				c.local_b[p] = rotate(res.points[p] - half_depth - b.pos, -b.angle);
+			}
+			// the last manifold is the one reported in the contact events
+			pair.coll = std::move(res);
+		}
+	};
+
+	std::span<xpbd_contact> all(xpbd_contacts);
+	auto range = [&](std::uint32_t begin, std::uint32_t end) { return all.subspan(begin, end - begin); };
+	auto island_contacts = range(isl.contacts.begin, isl.contacts.end);
+
+	// calls f on the joints of each color, one type after another
+	auto joint_colors = [&](auto &&f)
+	{
+		for_each_joint_bucket([&](auto &bucket)
+		{
+			using T = typename std::remove_reference_t<decltype(bucket)>::value_type;
+			constexpr auto kind = static_cast<std::size_t>(T::kind);
+
+			auto items = std::as_const(bucket).items();
+			for_each_color(isl, isl.constraint_colors[kind], constraint_colors[kind], [&](std::uint32_t begin, std::uint32_t end)
+			{
+				f(items.subspan(begin, end - begin));
+			});
+		});
+	};
+
+	for (int s = 0; s < std::max(solver.substeps, 1); ++s)
+	{
+		for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end) { xpbd_integrate(xpbd_bodies, ids(begin, end), h); });
+		for_each_chunk(isl, isl.contacts, collide);
+
+		for_each_distance_bucket([&](auto &bucket)
+		{
+			using T = typename std::remove_reference_t<decltype(bucket)>::value_type;
+			constexpr auto kind = static_cast<std::size_t>(T::kind);
+
+			auto items = std::as_const(bucket).items();
+			for_each_color(isl, isl.constraint_colors[kind], constraint_colors[kind], [&](std::uint32_t begin, std::uint32_t end)
+			{
+				xpbd_solve_constraints(xpbd_bodies, items.subspan(begin, end - begin), h);
+			});
+		});
+		joint_colors([&](auto joints) { xpbd_solve_joints(xpbd_bodies, joints, h); });
+		for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+		{
+			xpbd_solve_contacts(xpbd_bodies, range(begin, end), h);
+		});
+
+		for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end) { xpbd_update_velocities(xpbd_bodies, ids(begin, end), h); });
+		joint_colors([&](auto joints) { xpbd_solve_joint_velocities(xpbd_bodies, joints, h); });
+		for_each_color(isl, isl.contact_colors, contact_colors, [&](std::uint32_t begin, std::uint32_t end)
+		{
+			xpbd_solve_contact_velocities(xpbd_bodies, range(begin, end), h, solver.restitution_threshold);
+		});
+	}
+
+	for_each_chunk(isl, isl.bodies, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (auto id : ids(begin, end))
+		{
+			particle &pt = by_id[id]->pt;
+			const xpbd_body &b = xpbd_bodies[id];
+			pt.pos = b.pos;
+			pt.angle = b.angle;
+			pt.v = b.v;
+			pt.w = b.w;
+		}
+	});
+	for (auto i = isl.contacts.begin; i < isl.contacts.end; ++i)
+		collisions[i].impulse = xpbd_contacts[i].impulse;
+
+	isl.sleepy = solver.sleeping;
+	if (solver.sleeping)
+		for (auto i = isl.bodies.begin; i < isl.bodies.end; ++i)
+			isl.sleepy &= update_sleep_time(*by_id[island_bodies[i]]);
+}
+
+void world::update_impulse_cache()
+{
+	impulse_cache.clear();
+	for (std::size_t i = 0; i < collisions.size(); ++i)
+	{
+		const auto &c = contact_constraints[i];
+		auto &e = impulse_cache.emplace_back();
+		e.key = pair_key(c.a, c.b);
+		e.pieces = pieces_key(c.a, c.b, collisions[i].coll);
+		collisions[i].impulse = 0;
+		for (std::uint32_t p = 0; p < 2; ++p)
+		{
+			e.normal[p] = p < c.point_count ? c.points[p].normal_impulse : 0;
+			e.tangent[p] = p < c.point_count ? c.points[p].tangent_impulse : 0;
+			collisions[i].impulse += e.normal[p];
+		}
+	}
+	std::sort(impulse_cache.begin(), impulse_cache.end(), [](const cached_impulse &l, const cached_impulse &r)
+	{
+		return std::pair(l.key, l.pieces) < std::pair(r.key, r.pieces);
+	});
+}
+
+// diffs the touching pairs with the last step's to make begin, persist and end events
+void world::update_contacts()
+{
+	auto step = static_cast<std::uint32_t>(counters.steps - 1);
+	resting.clear();
+
+	touching.clear();
+	for (std::uint32_t i = 0; i < collisions.size(); ++i)
+	{
+		touching.push_back({pair_key(collisions[i].a->id, collisions[i].b->id), i});
+	}
+	std::sort(touching.begin(), touching.end());
+
+	// a pair touching with several pieces is one contact, reported with its deepest manifold and the impulses of all
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < touching.size(); ++i)
+	{
+		if (kept == 0 || touching[kept - 1].first != touching[i].first)
+		{
+			touching[kept++] = touching[i];
+			continue;
+		}
+
+		auto &deepest = touching[kept - 1].second;
+		float impulse = collisions[deepest].impulse + collisions[touching[i].second].impulse;
+		if (collisions[touching[i].second].coll.dist > collisions[deepest].coll.dist)
+			deepest = touching[i].second;
+		collisions[deepest].impulse = impulse;
+	}
+	touching.resize(kept);
+
+	auto event = [&](contact_event::kind type, std::uint32_t i)
+	{
+		const auto &c = collisions[i];
+		bool flip = c.a->id > c.b->id;
+		contacts.push_back({type, step, &*(flip ? c.b : c.a), &*(flip ? c.a : c.b),
+			flip ? -c.coll.normal : c.coll.normal, {c.coll.points[0], c.coll.points[1]}, c.coll.point_count, c.impulse});
+	};
+
+	auto cur = touching.begin();
+	auto prev = prev_touching.begin();
+	while (cur != touching.end() || prev != prev_touching.end())
+	{
+		if (prev == prev_touching.end() || (cur != touching.end() && cur->first < *prev))
+			event(contact_event::kind::begin, cur++->second);
+		else if (cur == touching.end() || *prev < cur->first)
+		{
+			object *a = &*by_id[*prev >> 32], *b = &*by_id[*prev & 0xffffffff];
+			// sleeping pairs aren't tested, they keep touching without events until they wake
+			if (!is_moving(*a) && !is_moving(*b))
+				resting.push_back(*prev);
+			else
+				contacts.push_back({contact_event::kind::end, step, a, b, {0, 0}, {}, 0, 0});
+			++prev;
+		}
+		else
+		{
+			event(contact_event::kind::persist, cur++->second);
+			++prev;
+		}
+	}
+
+	prev_touching.clear();
+	for (auto [key, i] : touching)
+		prev_touching.push_back(key);
+
+	std::size_t middle = prev_touching.size();
+	prev_touching.insert(prev_touching.end(), resting.begin(), resting.end());
+	std::inplace_merge(prev_touching.begin(), prev_touching.begin() + middle, prev_touching.end());
+}
+
+// boolean overlap tests for the sensor pairs, the overlaps are diffed with the last step's to make events
+void world::update_sensors()
+{
+	std::swap(overlaps, prev_overlaps);
+	overlaps.clear();
+
+	for (auto [sensor, visitor] : sensor_pairs)
+	{
+		++counters.sensor_tests;
+		if (physics::overlaps(view_of(*sensor), view_of(*visitor)))
+			overlaps.push_back(std::uint64_t{sensor->id} << 32 | visitor->id);
+	}
+
+	std::sort(overlaps.begin(), overlaps.end());
+
+	auto event = [&](std::uint64_t key, bool begin)
+	{
+		events.push_back({&*by_id[key >> 32], &*by_id[key & 0xffffffff], begin});
+	};
+
+	auto cur = overlaps.begin();
+	auto prev = prev_overlaps.begin();
+	while (cur != overlaps.end() || prev != prev_overlaps.end())
+	{
+		if (prev == prev_overlaps.end() || (cur != overlaps.end() && *cur < *prev))
+			event(*cur++, true);
+		else if (cur == overlaps.end() || *prev < *cur)
+			event(*prev++, false);
+		else
+			++cur, ++prev;
+	}
+}
+
+// finds the contacts of the step, the overlaps are left for the solver to push apart
 void world::resolve_bounds()
 {
 	constexpr float epsilon = 1E-6f;
 
 	collisions.clear();
 
-	objects.sort(object_compare<object>); // temporary solution
+	update_broadphase();
 	
-	auto a_end = std::prev(objects.end());
-	for (auto a = objects.begin(); a != a_end; ++a)
+	for (auto [a, b] : pairs)
 	{
-		for (auto b = std::next(a); b != objects.end(); ++b)
+		// xpbd collides the pairs on every substep, here it only keeps those whose bounds meet during the step
+		if (solver.mode == solver_mode::xpbd)
 		{
-			shape_view a_view(*a->shape, a->pt.pos, a->scale, a->pt.angle);
-			shape_view b_view(*b->shape, b->pt.pos, b->scale, b->pt.angle);
-
-			auto res = collides(a_view, b_view);
-			if (!res)
+			if (!swept_bounds(*a, solver.xpbd_step).overlaps(swept_bounds(*b, solver.xpbd_step)))
 				continue;
+
+			// every pair of pieces that may meet during the step is a contact of its own
+			pieces.clear();
+			piece_pairs(view_of(*a), view_of(*b), sweep_distance(*a, solver.xpbd_step) + sweep_distance(*b, solver.xpbd_step), pieces);
+			for (auto p : pieces)
+			{
+				collisions.push_back({a, b, {}});
+				collisions.back().coll.piece_a = p.a;
+				collisions.back().coll.piece_b = p.b;
+			}
+
+			counters.narrowphase_tests += std::max(solver.substeps, 1);
+			wake(*a);
+			wake(*b);
+			continue;
+		}
+
+		shape_view a_view = view_of(*a);
+		shape_view b_view = view_of(*b);
+
+		++counters.narrowphase_tests;
+		manifolds.clear();
+		collides(a_view, b_view, manifolds);
+
+		bool touches = false;
+		for (auto &res : manifolds)
+		{
 			auto mtv = res.normal * res.dist;
 			if (std::abs(mtv.x) < epsilon && std::abs(mtv.y) < epsilon)
 				continue;
 
-			collisions.push_back({a, b, res});
-			
-			bool a_inf = a->pt.m == particle::infinity;
-			// bool b_inf = b->pt.m == particle::infinity;
+			++counters.collisions;
+			collisions.push_back({a, b, std::move(res)});
+			touches = true;
+		}
 
-			if (a_inf)
-				b->pt.pos -= mtv;
-			// else if (b_inf)
-			// 	a->pt.pos += mtv;
-			else
-				a->pt.pos += mtv;
+		// one of them is moving, so the other's island has to move too
+		if (touches)
+		{
+			wake(*a);
+			wake(*b);
 		}
 	}
 }
@@ -0,0 +1,363 @@
+#include "xpbd.h"
+
+#include <algorithm>
+
+PHYSICS_BEG
+
+void xpbd_integrate(std::span<xpbd_body> bodies, std::span<const std::uint32_t> ids, float h)
+{
+	for (auto id : ids)
+	{
+		xpbd_body &b = bodies[id];
+		b.prev_pos = b.pos;
+		b.prev_angle = b.angle;
+		b.v += b.a * h;
+		b.w += b.alpha * h;
+		b.pos += b.v * h;
+		b.angle += b.w * h;
+	}
+}
+
+void xpbd_update_velocities(std::span<xpbd_body> bodies, std::span<const std::uint32_t> ids, float h)
+{
+	for (auto id : ids)
+	{
+		xpbd_body &b = bodies[id];
+		b.v = (b.pos - b.prev_pos) / h;
+		b.w = (b.angle - b.prev_angle) / h;
+	}
+}
+
+// ropes only pull, so they skip the constraints that are shorter than their distance
+template <bool rope, typename T>
+static void solve_distance(std::span<xpbd_body> bodies, std::span<const T> constraints, float h)
+{
+	for (const auto &c : constraints)
+	{
+		xpbd_body &a = bodies[c.a];
+		xpbd_body &b = bodies[c.b];
+
+		float w = a.inv_m + b.inv_m;
+		glm::vec2 rel_pos = a.pos - b.pos;
+		float cur_dist = glm::length(rel_pos);
+		float error = cur_dist - c.dist;
+		if (w <= 0 || cur_dist == 0 || (rope ? error <= 0 : error == 0))
+			continue;
+
+		// compliance scaled by the substep, so a spring is as stiff whatever the step
+		float lambda = -error / (w + c.compliance / (h * h));
+		glm::vec2 correction = rel_pos / cur_dist * lambda;
+
+		// constraints sharing a static object can run in parallel, so it is never written to
+		if (a.inv_m != 0)
+			a.pos += correction * a.inv_m;
+		if (b.inv_m != 0)
+			b.pos -= correction * b.inv_m;
+	}
+}
+
+void xpbd_solve_constraints(std::span<xpbd_body> bodies, std::span<const position_constraint> constraints, float h)
+{
+	solve_distance<false>(bodies, constraints, h);
+}
+
+void xpbd_solve_constraints(std::span<xpbd_body> bodies, std::span<const rope_constraint> constraints, float h)
+{
+	solve_distance<true>(bodies, constraints, h);
+}
+
+// inverse mass of the pair along dir at the offsets ra and rb
+static float generalized_inv_mass(const xpbd_body &a, const xpbd_body &b, glm::vec2 ra, glm::vec2 rb, glm::vec2 dir)
+{
+	float ca = cross(ra, dir), cb = cross(rb, dir);
+	return a.inv_m + a.inv_I * ca * ca + b.inv_m + b.inv_I * cb * cb;
+}
+
+// moves a by p at ra and b by -p at rb, static objects are shared between contacts of a color, so they are never written to
+static void apply_correction(xpbd_body &a, xpbd_body &b, glm::vec2 ra, glm::vec2 rb, glm::vec2 p)
+{
+	if (a.inv_m != 0)
+	{
+		a.pos += p * a.inv_m;
+		a.angle += a.inv_I * cross(ra, p);
+	}
+	if (b.inv_m != 0)
+	{
+		b.pos -= p * b.inv_m;
+		b.angle -= b.inv_I * cross(rb, p);
+	}
+}
+
+// moves the points at ra and rb together along dir by error, the distance of b's point ahead of a's along dir
+static void close_along(xpbd_body &a, xpbd_body &b, glm::vec2 ra, glm::vec2 rb, glm::vec2 dir, float error)
+{
+	float w = generalized_inv_mass(a, b, ra, rb, dir);
+	if (w > 0 && error != 0)
+		apply_correction(a, b, ra, rb, dir * (error / w));
+}
+
+// moves the anchors of the joint onto each other
+static void close_gap(xpbd_body &a, xpbd_body &b, glm::vec2 ra, glm::vec2 rb)
+{
+	glm::vec2 gap = b.pos + rb - a.pos - ra;
+	float length = glm::length(gap);
+	if (length != 0)
+		close_along(a, b, ra, rb, gap / length, length);
+}
+
+// turns the objects so the angle of b relative to a shrinks by error
+static void close_angle(xpbd_body &a, xpbd_body &b, float error)
+{
+	float w = a.inv_I + b.inv_I;
+	if (w <= 0 || error == 0)
+		return;
+	if (a.inv_m != 0)
+		a.angle += a.inv_I * error / w;
+	if (b.inv_m != 0)
+		b.angle -= b.inv_I * error / w;
+}
+
+// how far value is outside of [lower, upper], negative below it
+static float outside(float value, float lower, float upper)
+{
+	return value < lower ? value - lower : value > upper ? value - upper : 0;
+}
+
+// changes the velocities by impulse at ra and rb, b gets it and a the opposite
+static void apply_velocity_impulse(xpbd_body &a, xpbd_body &b, glm::vec2 ra, glm::vec2 rb, glm::vec2 impulse, float angular)
+{
+	if (a.inv_m != 0)
+	{
+		a.v -= impulse * a.inv_m;
+		a.w -= a.inv_I * (cross(ra, impulse) + angular);
+	}
+	if (b.inv_m != 0)
+	{
+		b.v += impulse * b.inv_m;
+		b.w += b.inv_I * (cross(rb, impulse) + angular);
+	}
+}
+
+// the limit first, so the anchors stay together whatever it turned
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const revolute_joint> joints, float)
+{
+	for (const auto &j : joints)
+	{
+		xpbd_body &a = bodies[j.a];
+		xpbd_body &b = bodies[j.b];
+
+		if (j.limit)
+			close_angle(a, b, outside(b.angle - a.angle - j.reference_angle, j.lower_angle, j.upper_angle));
+		close_gap(a, b, rotate(j.local_a, a.angle), rotate(j.local_b, b.angle));
+	}
+}
+
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const prismatic_joint> joints, float)
+{
+	for (const auto &j : joints)
+	{
+		xpbd_body &a = bodies[j.a];
+		xpbd_body &b = bodies[j.b];
+
+		close_angle(a, b, b.angle - a.angle - j.reference_angle);
+
+		glm::vec2 ra = rotate(j.local_a, a.angle);
+		glm::vec2 rb = rotate(j.local_b, b.angle);
+		glm::vec2 axis = rotate(j.local_axis, a.angle);
+		glm::vec2 perp{-axis.y, axis.x};
+		glm::vec2 gap = b.pos + rb - a.pos - ra;
+		close_along(a, b, ra, rb, perp, glm::dot(gap, perp));
+
+		if (j.limit)
+		{
+			ra = rotate(j.local_a, a.angle);
+			rb = rotate(j.local_b, b.angle);
+			float translation = glm::dot(b.pos + rb - a.pos - ra, axis);
+			close_along(a, b, ra, rb, axis, outside(translation, j.lower_translation, j.upper_translation));
+		}
+	}
+}
+
+void xpbd_solve_joints(std::span<xpbd_body> bodies, std::span<const weld_joint> joints, float)
+{
+	for (const auto &j : joints)
+	{
+		xpbd_body &a = bodies[j.a];
+		xpbd_body &b = bodies[j.b];
+
+		close_angle(a, b, b.angle - a.angle - j.reference_angle);
+		close_gap(a, b, rotate(j.local_a, a.angle), rotate(j.local_b, b.angle));
+	}
+}
+
+void xpbd_solve_joints(std::span<xpbd_body>, std::span<const motor_joint>, float) {}
+
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const revolute_joint> joints, float h)
+{
+	for (const auto &j : joints)
+	{
+		xpbd_body &a = bodies[j.a];
+		xpbd_body &b = bodies[j.b];
+
+		float w = a.inv_I + b.inv_I;
+		if (!j.motor || w <= 0)
+			continue;
+
+		float max = j.max_motor_torque * h;
+		float impulse = std::clamp((j.motor_speed - (b.w - a.w)) / w, -max, max);
+		apply_velocity_impulse(a, b, {0, 0}, {0, 0}, {0, 0}, impulse);
+	}
+}
+
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const prismatic_joint> joints, float h)
+{
+	for (const auto &j : joints)
+	{
+		xpbd_body &a = bodies[j.a];
+		xpbd_body &b = bodies[j.b];
+		if (!j.motor)
+			continue;
+
+		glm::vec2 ra = rotate(j.local_a, a.angle);
+		glm::vec2 rb = rotate(j.local_b, b.angle);
+		glm::vec2 axis = rotate(j.local_axis, a.angle);
+		float w = generalized_inv_mass(a, b, ra, rb, axis);
+		if (w <= 0)
+			continue;
+
+		float speed = glm::dot(b.v + cross(b.w, rb) - a.v - cross(a.w, ra), axis);
+		float max = j.max_motor_force * h;
+		float impulse = std::clamp((j.motor_speed - speed) / w, -max, max);
+		apply_velocity_impulse(a, b, ra, rb, axis * impulse, 0);
+	}
+}
+
+void xpbd_solve_joint_velocities(std::span<xpbd_body>, std::span<const weld_joint>, float) {}
+
+// the same targets as the sequential impulses, the velocity closing correction_factor of the offset error per second
+void xpbd_solve_joint_velocities(std::span<xpbd_body> bodies, std::span<const motor_joint> joints, float h)
+{
+	for (const auto &j : joints)
+	{
+		xpbd_body &a = bodies[j.a];
+		xpbd_body &b = bodies[j.b];
+
+		float angular_mass = a.inv_I + b.inv_I;
+		if (angular_mass > 0)
+		{
+			float angular_error = b.angle - a.angle - j.angular_offset;
+			float max_torque = j.max_torque * h;
+			float angular = std::clamp(-(b.w - a.w + j.correction_factor * angular_error) / angular_mass, -max_torque, max_torque);
+			apply_velocity_impulse(a, b, {0, 0}, {0, 0}, {0, 0}, angular);
+		}
+
+		float linear_mass = a.inv_m + b.inv_m;
+		if (linear_mass > 0)
+		{
+			glm::vec2 linear_error = b.pos - a.pos - rotate(j.linear_offset, a.angle);
+			glm::vec2 impulse = -(b.v - a.v + j.correction_factor * linear_error) / linear_mass;
+			float max_force = j.max_force * h;
+			if (glm::dot(impulse, impulse) > max_force * max_force)
+				impulse = glm::normalize(impulse) * max_force;
+			apply_velocity_impulse(a, b, {0, 0}, {0, 0}, impulse, 0);
+		}
+	}
+}
+
+void xpbd_solve_contacts(std::span<xpbd_body> bodies, std::span<xpbd_contact> contacts, float h)
+{
+	for (auto &c : contacts)
+	{
+		xpbd_body &a = bodies[c.a];
+		xpbd_body &b = bodies[c.b];
+
+		for (std::uint32_t p = 0; p < c.point_count; ++p)
+		{
+			glm::vec2 ra = rotate(c.local_a[p], a.angle);
+			glm::vec2 rb = rotate(c.local_b[p], b.angle);
+
+			// before this substep's corrections, the velocities are still those of the last substep
+			glm::vec2 rel_vel = b.v + cross(b.w, rb) - a.v - cross(a.w, ra);
+			c.normal_velocity[p] = glm::dot(rel_vel, c.normal);
+			c.normal_lambda[p] = 0;
+
+			float depth = glm::dot(a.pos + ra - b.pos - rb, c.normal) - contact_slop;
+			if (depth <= 0)
+				continue;
+
+			float w = generalized_inv_mass(a, b, ra, rb, c.normal);
+			if (w <= 0)
+				continue;
+
+			float lambda = -depth / w;
+			apply_correction(a, b, ra, rb, c.normal * lambda);
+			c.normal_lambda[p] = lambda;
+			c.impulse -= lambda / h;
+
+			// static friction undoes the sliding of the points during the substep, unless it would take more than the friction cone allows
+			ra = rotate(c.local_a[p], a.angle);
+			rb = rotate(c.local_b[p], b.angle);
+			glm::vec2 slide = (a.pos + ra - a.prev_pos - rotate(c.local_a[p], a.prev_angle))
+				- (b.pos + rb - b.prev_pos - rotate(c.local_b[p], b.prev_angle));
+			slide -= c.normal * glm::dot(slide, c.normal);
+
+			float slide_length = glm::length(slide);
+			if (slide_length == 0)
+				continue;
+
+			glm::vec2 tangent = slide / slide_length;
+			float tangent_lambda = -slide_length / generalized_inv_mass(a, b, ra, rb, tangent);
+			if (std::abs(tangent_lambda) < c.friction * std::abs(lambda))
+				apply_correction(a, b, ra, rb, tangent * tangent_lambda);
+		}
+	}
+}
+
+void xpbd_solve_contact_velocities(std::span<xpbd_body> bodies, std::span<xpbd_contact> contacts, float h, float restitution_threshold)
+{
+	for (auto &c : contacts)
+	{
+		xpbd_body &a = bodies[c.a];
+		xpbd_body &b = bodies[c.b];
+
+		for (std::uint32_t p = 0; p < c.point_count; ++p)
+		{
+			if (c.normal_lambda[p] == 0)
+				continue;
+
+			glm::vec2 ra = rotate(c.local_a[p], a.angle);
+			glm::vec2 rb = rotate(c.local_b[p], b.angle);
+			glm::vec2 rel_vel = b.v + cross(b.w, rb) - a.v - cross(a.w, ra);
+			float normal_vel = glm::dot(rel_vel, c.normal);
+			glm::vec2 tangent_vel = rel_vel - c.normal * normal_vel;
+
+			// dynamic friction, at most the normal force of the substep times the friction
+			glm::vec2 change{0, 0};
+			float tangent_speed = glm::length(tangent_vel);
+			if (tangent_speed != 0)
+				change -= tangent_vel / tangent_speed * std::min(c.friction * std::abs(c.normal_lambda[p]) / h, tangent_speed);
+
+			// the push out of the overlap must not turn into a bounce, only restitution separates
+			float restitution = -c.normal_velocity[p] > restitution_threshold ? c.restitution : 0;
+			change += c.normal * (std::max(-restitution * c.normal_velocity[p], 0.f) - normal_vel);
+
+			float change_length = glm::length(change);
+			if (change_length == 0)
+				continue;
+
+			glm::vec2 impulse = change / generalized_inv_mass(a, b, ra, rb, change / change_length);
+			if (a.inv_m != 0)
+			{
+				a.v -= impulse * a.inv_m;
+				a.w -= a.inv_I * cross(ra, impulse);
+			}
+			if (b.inv_m != 0)
+			{
+				b.v += impulse * b.inv_m;
+				b.w += b.inv_I * cross(rb, impulse);
+			}
+		}
+	}
+}
+
+PHYSICS_END